@@ -0,0 +1,102 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "album_art_cache.h"
+
+// Standard library includes
+#include <algorithm>
+
+// local includes
+#include "constants.h"
+
+AlbumArtCache::AlbumArtCache()
+    : sources(),
+      order(),
+      recent_art_dir(),
+      recent_art(),
+      recent_art_mime_type() {}
+
+const AlbumArtSource *AlbumArtCache::find(std::string_view filename) const {
+  auto iter = sources.find(directory_of(filename));
+  return iter == sources.end() ? nullptr : &iter->second;
+}
+
+void AlbumArtCache::record(std::string_view filename, bool from_albumart,
+                           bool found, size_t size) {
+  std::string_view dir = directory_of(filename);
+  auto iter = sources.find(dir);
+  if (iter == sources.end()) {
+    if (order.size() >= MPD_CLI_ART_CACHE_DIRS) {
+      sources.erase(order.front());
+      order.pop_front();
+    }
+    order.emplace_back(dir);
+    iter = sources.emplace(order.back(), AlbumArtSource()).first;
+  }
+
+  AlbumArtSource &source = iter->second;
+  AlbumArtSource::Result result =
+      found ? AlbumArtSource::FOUND : AlbumArtSource::MISSING;
+  if (from_albumart) {
+    source.albumart = result;
+  } else {
+    source.readpicture = result;
+  }
+  if (found) {
+    source.size = size;
+  }
+}
+
+void AlbumArtCache::clear() {
+  sources.clear();
+  order.clear();
+  forget_recent_art();
+}
+
+size_t AlbumArtCache::size() const { return sources.size(); }
+
+void AlbumArtCache::set_recent_art(std::string_view filename,
+                                   std::shared_ptr<std::vector<char> > art,
+                                   std::string_view mime_type) {
+  recent_art_dir.assign(directory_of(filename));
+  recent_art = std::move(art);
+  recent_art_mime_type.assign(mime_type);
+}
+
+std::shared_ptr<std::vector<char> > AlbumArtCache::find_same_art(
+    std::string_view filename, size_t size, std::string_view head,
+    std::string_view mime_type) const {
+  if (!recent_art || recent_art->size() != size || head.size() > size ||
+      recent_art_dir != directory_of(filename) ||
+      recent_art_mime_type != mime_type ||
+      !std::equal(head.begin(), head.end(), recent_art->begin())) {
+    return nullptr;
+  }
+  return recent_art;
+}
+
+void AlbumArtCache::forget_recent_art() {
+  recent_art_dir.clear();
+  recent_art.reset();
+  recent_art_mime_type.clear();
+}
+
+std::string_view AlbumArtCache::directory_of(std::string_view filename) {
+  size_t slash_idx = filename.rfind('/');
+  return slash_idx == std::string_view::npos ? std::string_view()
+                                             : filename.substr(0, slash_idx);
+}
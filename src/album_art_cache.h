@@ -0,0 +1,95 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_ALBUM_ART_CACHE_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_ALBUM_ART_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// What is known about the album art of the songs in one directory.
+struct AlbumArtSource {
+  enum Result : uint8_t { UNKNOWN = 0, FOUND, MISSING };
+
+  // "readpicture" (embedded picture) result of the last song tried
+  Result readpicture = UNKNOWN;
+  // "albumart" (cover file) result, the same for every song in the directory
+  Result albumart = UNKNOWN;
+  // size of the album art last found
+  size_t size = 0;
+};
+
+/// Remembers which album art command works for the songs of a directory, so
+/// the next songs from the same album go straight to it. Holds at most
+/// MPD_CLI_ART_CACHE_DIRS directories, the oldest is dropped first.
+/// Also keeps the last cover file fetched with "albumart", so that the next
+/// songs of the directory don't fetch it again.
+class AlbumArtCache {
+ public:
+  AlbumArtCache();
+
+  /// Returns nullptr if nothing is known about the directory of "filename".
+  const AlbumArtSource *find(std::string_view filename) const;
+  /// Records the result of "albumart" (if "from_albumart") or "readpicture"
+  /// for "filename". "size" is only used if "found".
+  void record(std::string_view filename, bool from_albumart, bool found,
+              size_t size);
+  void clear();
+  size_t size() const;
+
+  /// Keeps "art" as the last cover fetched, for "find_same_art()".
+  void set_recent_art(std::string_view filename,
+                      std::shared_ptr<std::vector<char> > art,
+                      std::string_view mime_type);
+  /// Returns the last cover fetched if it is from the directory of
+  /// "filename", has the same size and mime type, and starts with "head"
+  /// (the first chunk fetched for "filename"). Returns nullptr otherwise.
+  std::shared_ptr<std::vector<char> > find_same_art(
+      std::string_view filename, size_t size, std::string_view head,
+      std::string_view mime_type) const;
+  void forget_recent_art();
+
+  /// Returns the part of "filename" before its last '/', or "" if there is
+  /// none.
+  static std::string_view directory_of(std::string_view filename);
+
+ private:
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const {
+      return std::hash<std::string_view>{}(str);
+    }
+  };
+
+  std::unordered_map<std::string, AlbumArtSource, StringHash,
+                     std::equal_to<> >
+      sources;
+  // directories in the order they were added
+  std::deque<std::string> order;
+  std::string recent_art_dir;
+  std::shared_ptr<std::vector<char> > recent_art;
+  std::string recent_art_mime_type;
+};
+
+#endif
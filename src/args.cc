@@ -127,6 +127,9 @@ Args::Args(int argc, char **argv)
       host_ip_addr(),
       default_font_filename(),
       password_file(),
+      connect_timeout(MPD_CLI_CONNECT_TIMEOUT),
+      heartbeat_interval(MPD_CLI_HEARTBEAT_INTERVAL),
+      trace_file(),
       text_bg_opacity(0.745),
       font_scale_factor(1.0F),
       remaining_font_scale_factor(1.0F),
@@ -166,6 +169,26 @@ Args::Args(int argc, char **argv)
         return;
       }
       host_port = static_cast<uint16_t>(p);
+    } else if (std::strncmp("--connect-timeout=", argv[0], 18) == 0) {
+      char *end = nullptr;
+      unsigned long long ms = std::strtoull(argv[0] + 18, &end, 10);
+      if (end == argv[0] + 18 || *end != 0 || ms == 0) {
+        PrintHelper::println(
+            stderr, "ERROR: --connect-timeout must be a positive integer!");
+        flags.set(0);
+        return;
+      }
+      connect_timeout = std::chrono::milliseconds(ms);
+    } else if (std::strncmp("--heartbeat-interval=", argv[0], 21) == 0) {
+      char *end = nullptr;
+      unsigned long long ms = std::strtoull(argv[0] + 21, &end, 10);
+      if (end == argv[0] + 21 || *end != 0 || ms == 0) {
+        PrintHelper::println(
+            stderr, "ERROR: --heartbeat-interval must be a positive integer!");
+        flags.set(0);
+        return;
+      }
+      heartbeat_interval = std::chrono::milliseconds(ms);
     } else if (std::strcmp("--disable-all-text", argv[0]) == 0) {
       flags.set(9);
     } else if (std::strcmp("--disable-show-title", argv[0]) == 0) {
@@ -188,6 +211,8 @@ Args::Args(int argc, char **argv)
                            "is the default behavior.");
     } else if (std::strncmp("--pfile=", argv[0], 8) == 0) {
       password_file = std::string(argv[0] + 8);
+    } else if (std::strncmp("--record-trace=", argv[0], 15) == 0) {
+      trace_file = std::string(argv[0] + 15);
     } else if (std::strcmp("--no-scale-fill", argv[0]) == 0) {
       flags.set(7);
     } else if (std::strcmp("--align-album-art-left", argv[0]) == 0) {
@@ -418,9 +443,18 @@ void Args::print_usage() {
   PrintHelper::println("Usage:");
   PrintHelper::println("  -h | --help : show this usage text");
   PrintHelper::println("  --version : show the version of this program");
-  PrintHelper::println("  --host=<ip_addr> : ip address of mpd server");
+  PrintHelper::println(
+      "  --host=<host> : host name or ip address (IPv4 or IPv6) of mpd server");
   PrintHelper::println("  --host-socket=<path> : unix socket of mpd server");
   PrintHelper::println("  --port=<port> : port of mpd server (default 6600)");
+  PrintHelper::println(
+      "  --connect-timeout=<milliseconds> : give up connecting to mpd server "
+      "after this long (default {})",
+      MPD_CLI_CONNECT_TIMEOUT.count());
+  PrintHelper::println(
+      "  --heartbeat-interval=<milliseconds> : check the connection to mpd "
+      "server after this long without hearing from it (default {})",
+      MPD_CLI_HEARTBEAT_INTERVAL.count());
   PrintHelper::println("  --disable-all-text : disables showing all text");
   PrintHelper::println("  --disable-show-title : disable showing song title");
   PrintHelper::println("  --disable-show-artist : disable showing song artist");
@@ -436,6 +470,9 @@ void Args::print_usage() {
       "  --pprompt : deprecated; it is the default to prompt for password");
   PrintHelper::println(
       "  --pfile=<filename> : get password from specified file");
+  PrintHelper::println(
+      "  --record-trace=<filename> : record everything sent to and received "
+      "from mpd server to the file");
   PrintHelper::println(
       "  --no-scale-fill : don't scale fill the album art to the window");
   PrintHelper::println(
@@ -535,6 +572,10 @@ const std::optional<std::string> &Args::get_password_file() const {
   return password_file;
 }
 
+const std::optional<std::string> &Args::get_trace_file() const {
+  return trace_file;
+}
+
 double Args::get_text_bg_opacity() const { return text_bg_opacity; }
 
 float Args::get_font_scale_factor() const { return font_scale_factor; }
@@ -547,6 +588,14 @@ LogLevel Args::get_log_level() const { return level; }
 
 uint16_t Args::get_host_port() const { return host_port; }
 
+std::chrono::milliseconds Args::get_connect_timeout() const {
+  return connect_timeout;
+}
+
+std::chrono::milliseconds Args::get_heartbeat_interval() const {
+  return heartbeat_interval;
+}
+
 uint8_t Args::get_bg_grayscale() const { return bg_grayscale; }
 
 const std::unique_ptr<Color> &Args::get_text_fg_color() const {
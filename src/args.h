@@ -18,6 +18,7 @@
 #define SEODISPARATE_COM_MPD_INFO_SCREEN_2_ARGS_H_
 
 #include <bitset>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -42,11 +43,14 @@ class Args {
   const std::string &get_host_ip_addr() const;
   const std::string &get_host_unix_socket() const;
   const std::optional<std::string> &get_password_file() const;
+  const std::optional<std::string> &get_trace_file() const;
   double get_text_bg_opacity() const;
   float get_font_scale_factor() const;
   float get_remaining_font_scale_factor() const;
   LogLevel get_log_level() const;
   uint16_t get_host_port() const;
+  std::chrono::milliseconds get_connect_timeout() const;
+  std::chrono::milliseconds get_heartbeat_interval() const;
   const std::string &get_default_font_filename() const;
   const std::unordered_set<std::string> &get_font_blacklist_strings() const;
   const std::unordered_set<std::string> &get_font_whitelist_strings() const;
@@ -97,6 +101,9 @@ class Args {
   std::optional<std::string> password_file;
   std::unique_ptr<Color> text_fg_color;
   std::unique_ptr<Color> text_bg_color;
+  std::chrono::milliseconds connect_timeout;
+  std::chrono::milliseconds heartbeat_interval;
+  std::optional<std::string> trace_file;
   double text_bg_opacity;
   float font_scale_factor;
   float remaining_font_scale_factor;
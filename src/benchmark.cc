@@ -0,0 +1,268 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+// Times album art fetches from a "MockMPD", to compare changes to
+// MPDClient's socket I/O, optionally with added latency and limited
+// bandwidth. Runs once with "send()"/"recv()" and, if built with
+// USE_IO_URING, once more with io_uring. Or, with "--replay=", drives
+// MPDClient against a session recorded with "--record-trace=" and reports the
+// latency of each command.
+// Not run by the unit tests.
+//
+// Usage: benchmark [fetch count] [album art KiB] [latency ms] [KiB/s]
+//        benchmark --replay=<trace file> [speed (default 1, 0 for no delays)]
+
+// Standard library includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Unix includes
+#include <sys/resource.h>
+#include <unistd.h>
+
+// local includes
+#include "io_uring_socket.h"
+#include "mock_mpd.h"
+#include "mpd_client.h"
+#include "print_helper.h"
+#include "protocol_trace.h"
+#include "response_parser.h"
+#include "trace_replay.h"
+
+namespace {
+
+// CPU time (user and system) used by the calling thread so far.
+std::chrono::microseconds thread_cpu_time() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return std::chrono::microseconds(0);
+  }
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         std::chrono::microseconds(usage.ru_utime.tv_usec +
+                                   usage.ru_stime.tv_usec);
+}
+
+// Name of the command in a request, the first command of a command list.
+std::string command_name(std::string_view request) {
+  if (request.starts_with("command_list")) {
+    size_t newline_idx = request.find('\n');
+    request = newline_idx == std::string_view::npos
+                  ? std::string_view()
+                  : request.substr(newline_idx + 1);
+  }
+  return std::string(request.substr(0, request.find_first_of(" \n")));
+}
+
+// Prints how long each kind of command took to be answered in "records".
+void print_command_latencies(
+    const std::vector<ProtocolTrace::Record> &records) {
+  struct ConnectionState {
+    ResponseParser parser;
+    std::string pending;
+    std::optional<std::chrono::microseconds> sent_time;
+    std::string command;
+  };
+  std::map<uint32_t, ConnectionState> connections;
+  std::map<std::string, std::vector<std::chrono::microseconds> > latencies;
+
+  for (const ProtocolTrace::Record &rec : records) {
+    ConnectionState &conn = connections[rec.connection];
+    if (rec.direction == ProtocolTrace::DIR_SENT) {
+      if (!conn.sent_time.has_value() || conn.command == "idle") {
+        // "noidle" ends a pending "idle", which is left out.
+        conn.sent_time = rec.time;
+        conn.command = command_name(rec.data);
+      }
+      continue;
+    }
+
+    conn.pending.append(rec.data);
+    while (conn.parser.next(conn.pending).type !=
+           ResponseParser::EV_NEED_MORE) {
+      if (conn.parser.done()) {
+        if (conn.sent_time.has_value() && conn.command != "idle") {
+          latencies[conn.command].push_back(rec.time - *conn.sent_time);
+        }
+        conn.sent_time.reset();
+        conn.pending.erase(0, conn.parser.take_parsed());
+        conn.parser.reset();
+      }
+    }
+    conn.pending.erase(0, conn.parser.take_parsed());
+  }
+
+  PrintHelper::println("command: count, p50 / p95 / max latency in us");
+  for (auto &[command, times] : latencies) {
+    std::sort(times.begin(), times.end());
+    PrintHelper::println("{}: {}, {} / {} / {}", command, times.size(),
+                         times[times.size() / 2].count(),
+                         times[times.size() * 95 / 100].count(),
+                         times.back().count());
+  }
+}
+
+int replay(const std::string &trace_file, double speed) {
+  std::optional<std::vector<ProtocolTrace::Record> > records =
+      ProtocolTrace::load(trace_file);
+  if (!records.has_value()) {
+    PrintHelper::println("ERROR: Failed to load trace \"{}\"!", trace_file);
+    return 1;
+  }
+
+  std::string path = std::format("/tmp/mpd_info_screen2_benchmark_{}.sock",
+                                 static_cast<int>(getpid()));
+  TraceReplayServer server(path, records.value(), speed);
+  std::thread server_thread(&TraceReplayServer::run, &server);
+
+  MPDClient cli(path, 0, LogLevel::SILENT, true);
+  auto trace = std::make_shared<ProtocolTrace>();
+  cli.set_trace(trace);
+  auto start = std::chrono::steady_clock::now();
+  while (cli.is_ok() &&
+         server.connections_done.load() < server.connection_count()) {
+    cli.update();
+    cli.wait_for_io(-1, 100);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  server.stop.store(true);
+  cli.reset_connection();
+  server_thread.join();
+  unlink(path.c_str());
+
+  PrintHelper::println(
+      "Replayed {} of {} connections in {} ms, {} lines differed",
+      server.connections_done.load(), server.connection_count(),
+      elapsed.count(), server.mismatches.load());
+  print_command_latencies(trace->get_records());
+  return 0;
+}
+
+struct FetchOptions {
+  int fetch_count = 0;
+  size_t art_size = 0;
+  std::chrono::milliseconds reply_delay = std::chrono::milliseconds(0);
+  size_t bytes_per_second = 0;
+};
+
+// Times "options.fetch_count" album art fetches through one I/O path of
+// MPDClient, and prints the results under "label".
+bool fetch_album_art(std::string_view label, const FetchOptions &options,
+                     bool use_io_uring) {
+  std::string path = std::format("/tmp/mpd_info_screen2_benchmark_{}.sock",
+                                 static_cast<int>(getpid()));
+  MockMPD server(path);
+  server.art_size = options.art_size;
+  server.reply_delay = options.reply_delay;
+  server.bytes_per_second = options.bytes_per_second;
+  std::thread server_thread(&MockMPD::run, &server);
+
+  MPDClient cli(path, 0, LogLevel::SILENT, true);
+  cli.set_io_uring(use_io_uring);
+  std::shared_ptr<const std::vector<char> > prev_art;
+  auto fetch = [&cli, &prev_art]() {
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const std::vector<char> > art;
+    cli.update();
+    while (!(art = cli.get_album_art()) || art == prev_art) {
+      if (!cli.is_ok() ||
+          std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) {
+        return false;
+      }
+      cli.wait_for_io(-1, 100);
+      cli.update();
+    }
+    prev_art = art;
+    return true;
+  };
+
+  // The first fetch also connects and settles "binarylimit".
+  bool ok = fetch();
+  if (ok && use_io_uring && !cli.is_using_io_uring()) {
+    PrintHelper::println("{}: not available, the kernel refused it", label);
+    ok = false;
+  }
+  std::chrono::microseconds cpu_before = thread_cpu_time();
+  auto start = std::chrono::steady_clock::now();
+  for (int idx = 0; ok && idx < options.fetch_count; ++idx) {
+    cli.request_refetch_album_art();
+    ok = fetch();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::chrono::microseconds cpu = thread_cpu_time() - cpu_before;
+
+  server.stop.store(true);
+  cli.reset_connection();
+  server_thread.join();
+  unlink(path.c_str());
+
+  if (!ok) {
+    PrintHelper::println("ERROR: Album art fetch failed!");
+    return false;
+  }
+
+  double seconds = static_cast<double>(elapsed.count()) / 1000000.0;
+  double mib = static_cast<double>(options.art_size) *
+               static_cast<double>(options.fetch_count) / (1024.0 * 1024.0);
+  PrintHelper::println("{}: {} fetches of {} KiB in {:.3f} s", label,
+                       options.fetch_count, options.art_size / 1024, seconds);
+  PrintHelper::println(
+      "{}: {:.1f} MiB/s, {:.1f} us per fetch", label, mib / seconds,
+      static_cast<double>(elapsed.count()) / options.fetch_count);
+  PrintHelper::println("{}: {:.1f} us of client CPU time per fetch", label,
+                       static_cast<double>(cpu.count()) / options.fetch_count);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strncmp("--replay=", argv[1], 9) == 0) {
+    return replay(argv[1] + 9, argc > 2 ? std::stod(argv[2]) : 1.0);
+  }
+
+  FetchOptions options;
+  options.fetch_count = argc > 1 ? std::stoi(argv[1]) : 50;
+  options.art_size =
+      (argc > 2 ? std::stoull(argv[2]) : static_cast<size_t>(4096)) * 1024;
+  if (argc > 3) {
+    options.reply_delay = std::chrono::milliseconds(std::stoi(argv[3]));
+  }
+  if (argc > 4) {
+    options.bytes_per_second = std::stoull(argv[4]) * 1024;
+  }
+
+  if (!fetch_album_art("send()/recv()", options, false)) {
+    return 1;
+  }
+  if (!IoUringSocket::is_built()) {
+    PrintHelper::println("io_uring: not built, build with USE_IO_URING");
+  } else if (!fetch_album_art("io_uring", options, true)) {
+    return 1;
+  }
+  return 0;
+}
@@ -27,16 +27,55 @@ constexpr int PPROMPT_FPS = 60;
 constexpr size_t READ_BUF_SIZE = 1024 * 1024;
 constexpr size_t READ_BUF_SIZE_SMALL = 1024;
 constexpr size_t MPD_BINARY_LIMIT = READ_BUF_SIZE - 100;
-constexpr std::chrono::milliseconds LOOP_SLEEP_TIME =
-    std::chrono::milliseconds(10);
-constexpr std::chrono::milliseconds UPDATE_INFO_INTERVAL =
-    std::chrono::milliseconds(3000);
+// MPD's default "binarylimit", also the smallest chunk worth measuring
+// throughput with.
+constexpr size_t MPD_BINARY_LIMIT_MIN = 8192;
+// "binarylimit" is adjusted so that one chunk takes about this long.
+constexpr std::chrono::milliseconds MPD_CLI_ART_CHUNK_TARGET =
+    std::chrono::milliseconds(100);
 constexpr std::chrono::seconds DEBUG_PRINT_INFO_INTERVAL =
     std::chrono::seconds(5);
 constexpr std::chrono::seconds MPD_CLI_READ_TIMEOUT = std::chrono::seconds(2);
 constexpr std::chrono::seconds MPD_CLI_WRITE_TIMEOUT = MPD_CLI_READ_TIMEOUT;
-constexpr std::chrono::milliseconds MPD_CLI_READ_BINARY_WAIT =
-    std::chrono::milliseconds(1);
+constexpr std::chrono::milliseconds MPD_CLI_CONNECT_TIMEOUT =
+    std::chrono::milliseconds(3000);
+constexpr std::chrono::milliseconds MPD_CLI_CONNECT_ATTEMPT_DELAY =
+    std::chrono::milliseconds(250);
+constexpr size_t MPD_CLI_MAX_CONNECT_ATTEMPTS = 4;
+constexpr std::chrono::milliseconds MPD_CLI_RESOLVE_POLL_INTERVAL =
+    std::chrono::milliseconds(10);
+constexpr int MPD_CLI_MAX_UPDATE_STEPS = 16;
+// While idling, "noidle" is sent once MPD hasn't been heard from for this
+// long, so a dead connection is noticed within this plus
+// MPD_CLI_READ_TIMEOUT. TCP keepalive probes start after the same time.
+constexpr std::chrono::milliseconds MPD_CLI_HEARTBEAT_INTERVAL =
+    std::chrono::milliseconds(15000);
+// TCP keepalive probes are sent this far apart, the connection is dropped
+// after MPD_CLI_KEEPALIVE_COUNT go unanswered.
+constexpr int MPD_CLI_KEEPALIVE_INTERVAL_SECS = 5;
+constexpr int MPD_CLI_KEEPALIVE_COUNT = 3;
+// Song info is fetched again between background requests once this old.
+constexpr std::chrono::milliseconds MPD_CLI_STATUS_DEADLINE =
+    std::chrono::milliseconds(1000);
+constexpr std::chrono::milliseconds MPD_CLI_ART_RECONNECT_DELAY =
+    std::chrono::milliseconds(1000);
+// Album art chunks requested at once, kept well below MPD's default
+// "max_output_buffer_size" of 8 MiB.
+constexpr size_t MPD_CLI_ART_PIPELINE_BYTES = 4 * 1024 * 1024;
+constexpr size_t MPD_CLI_ART_PIPELINE_MAX_CHUNKS = 64;
+// ... and, once the throughput is known, no more than what is expected to take
+// this long, to stay clear of MPD_CLI_READ_TIMEOUT.
+constexpr std::chrono::milliseconds MPD_CLI_ART_PIPELINE_TIME =
+    std::chrono::milliseconds(1000);
+// Song directories remembered in "AlbumArtCache".
+constexpr size_t MPD_CLI_ART_CACHE_DIRS = 256;
+// Buffers the io_uring backend receives into (a power of two of them), and
+// the most of a request it sends at once.
+constexpr size_t MPD_CLI_URING_RECV_BUF_SIZE = 32 * 1024;
+constexpr size_t MPD_CLI_URING_RECV_BUF_COUNT = 32;
+constexpr size_t MPD_CLI_URING_SEND_BUF_SIZE = 16 * 1024;
+constexpr std::chrono::milliseconds MPD_THREAD_WAIT_TIMEOUT =
+    std::chrono::milliseconds(100);
 constexpr int DISPLAY_BG_OPACITY = 200;
 constexpr int TEXT_LOAD_SIZE = 96;
 constexpr int TEXT_DEFAULT_SIZE = 48;
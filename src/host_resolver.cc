@@ -0,0 +1,191 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "host_resolver.h"
+
+// Standard library includes
+#include <cstring>
+#include <exception>
+#include <format>
+#include <optional>
+#include <thread>
+
+// Unix includes
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+// Local includes
+#include "helpers.h"
+
+HostResolver::HostResolver() : state() {}
+
+bool HostResolver::is_valid_host(const std::string &host) {
+  if (host.empty()) {
+    return false;
+  }
+
+  // Only digits and dots must be a full dotted IPv4 address, "getaddrinfo()"
+  // would otherwise accept shorthands like "127.1".
+  bool is_numeric = true;
+  for (char c : host) {
+    if ((c < '0' || c > '9') && c != '.') {
+      is_numeric = false;
+      break;
+    }
+  }
+  if (is_numeric) {
+    return helper_ipv4_str_to_value(host).has_value();
+  }
+
+  return host.find_first_of(" \t\r\n") == std::string::npos;
+}
+
+void HostResolver::start(const std::string &host, uint16_t port) {
+  state = std::make_shared<State>();
+  state->done.store(false);
+  state->error = 0;
+
+  SockAddr sock_addr;
+  std::memset(&sock_addr, 0, sizeof(SockAddr));
+
+  std::optional<uint32_t> ipv4_value = helper_ipv4_str_to_value(host);
+  if (ipv4_value.has_value()) {
+    struct sockaddr_in *ipv4_sockaddr =
+        reinterpret_cast<struct sockaddr_in *>(&sock_addr.addr);
+    ipv4_sockaddr->sin_family = AF_INET;
+    ipv4_sockaddr->sin_port = htons(port);
+    ipv4_sockaddr->sin_addr.s_addr = ipv4_value.value();
+    sock_addr.len = sizeof(struct sockaddr_in);
+    state->addrs.push_back(sock_addr);
+    state->done.store(true);
+    return;
+  }
+
+  // Allow "[::1]" style IPv6 addresses.
+  std::string ipv6_str = host;
+  if (ipv6_str.size() > 2 && ipv6_str.front() == '[' &&
+      ipv6_str.back() == ']') {
+    ipv6_str = ipv6_str.substr(1, ipv6_str.size() - 2);
+  }
+
+  struct sockaddr_in6 *ipv6_sockaddr =
+      reinterpret_cast<struct sockaddr_in6 *>(&sock_addr.addr);
+  if (inet_pton(AF_INET6, ipv6_str.c_str(), &ipv6_sockaddr->sin6_addr) == 1) {
+    ipv6_sockaddr->sin6_family = AF_INET6;
+    ipv6_sockaddr->sin6_port = htons(port);
+    sock_addr.len = sizeof(struct sockaddr_in6);
+    state->addrs.push_back(sock_addr);
+    state->done.store(true);
+    return;
+  }
+
+  // Join a lookup of the same host that is still running.
+  std::string key = std::format("{}:{}", host, port);
+  std::lock_guard<std::mutex> lock(running().mutex);
+  auto iter = running().lookups.find(key);
+  if (iter != running().lookups.end()) {
+    state = iter->second;
+    return;
+  }
+
+  try {
+    running().lookups.emplace(key, state);
+    std::thread([state = this->state, host, port, key]() {
+      struct addrinfo hints;
+      std::memset(&hints, 0, sizeof(struct addrinfo));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+
+      std::string port_str = std::to_string(port);
+      struct addrinfo *result = nullptr;
+      int ret = getaddrinfo(host.c_str(), port_str.c_str(), &hints, &result);
+      if (ret == 0) {
+        for (struct addrinfo *info = result; info != nullptr;
+             info = info->ai_next) {
+          if ((info->ai_family != AF_INET && info->ai_family != AF_INET6) ||
+              info->ai_addrlen > sizeof(struct sockaddr_storage)) {
+            continue;
+          }
+          SockAddr sock_addr;
+          std::memset(&sock_addr, 0, sizeof(SockAddr));
+          std::memcpy(&sock_addr.addr, info->ai_addr, info->ai_addrlen);
+          sock_addr.len = info->ai_addrlen;
+          state->addrs.push_back(sock_addr);
+        }
+        freeaddrinfo(result);
+        interleave_families(state->addrs);
+      } else {
+        state->error = ret;
+      }
+      state->done.store(true, std::memory_order_release);
+      std::lock_guard<std::mutex> lock(running().mutex);
+      running().lookups.erase(key);
+    }).detach();
+  } catch (const std::exception &e) {
+    running().lookups.erase(key);
+    state->error = EAI_SYSTEM;
+    state->done.store(true);
+  }
+}
+
+bool HostResolver::is_done() const {
+  return state && state->done.load(std::memory_order_acquire);
+}
+
+std::vector<SockAddr> HostResolver::take_results() {
+  if (!is_done()) {
+    return {};
+  }
+  // Other resolvers may share the lookup.
+  return state->addrs;
+}
+
+int HostResolver::get_error() const { return state ? state->error : 0; }
+
+HostResolver::Running &HostResolver::running() {
+  static Running *running = new Running();
+  return *running;
+}
+
+void HostResolver::interleave_families(std::vector<SockAddr> &addrs) {
+  if (addrs.empty()) {
+    return;
+  }
+
+  std::vector<SockAddr> first_family;
+  std::vector<SockAddr> other_family;
+  const auto family = addrs.front().addr.ss_family;
+  for (const SockAddr &addr : addrs) {
+    if (addr.addr.ss_family == family) {
+      first_family.push_back(addr);
+    } else {
+      other_family.push_back(addr);
+    }
+  }
+
+  addrs.clear();
+  for (size_t idx = 0;
+       idx < first_family.size() || idx < other_family.size(); ++idx) {
+    if (idx < first_family.size()) {
+      addrs.push_back(first_family[idx]);
+    }
+    if (idx < other_family.size()) {
+      addrs.push_back(other_family[idx]);
+    }
+  }
+}
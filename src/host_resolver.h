@@ -0,0 +1,93 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_HOST_RESOLVER_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_HOST_RESOLVER_H_
+
+// Standard library includes
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Unix includes
+#include <sys/socket.h>
+
+/// An address to "connect()" to.
+struct SockAddr {
+  struct sockaddr_storage addr;
+  socklen_t len;
+};
+
+/// Resolves a host name with "getaddrinfo()" on a detached thread, so a slow
+/// name server never stalls the caller. Numeric IPv4/IPv6 addresses are
+/// parsed right away without starting a thread. Resolvers started for a host
+/// and port that is still being resolved share that lookup, so abandoned
+/// lookups on a slow name server don't pile up.
+class HostResolver {
+ public:
+  HostResolver();
+
+  // No copy
+  HostResolver(const HostResolver &) = delete;
+  HostResolver &operator=(const HostResolver &) = delete;
+
+  // Allow move
+  HostResolver(HostResolver &&) = default;
+  HostResolver &operator=(HostResolver &&) = default;
+
+  /// Returns false for hosts that can never resolve, such as a malformed
+  /// dotted IPv4 address.
+  static bool is_valid_host(const std::string &host);
+
+  /// Abandons any resolution already in progress, unless it is for the same
+  /// host and port.
+  void start(const std::string &host, uint16_t port);
+  bool is_done() const;
+  /// Only valid once "is_done()". Empty if resolving failed. Addresses
+  /// alternate between IPv6 and IPv4 in the resolver's order of preference,
+  /// so racing connects try both families early (RFC 8305).
+  std::vector<SockAddr> take_results();
+  /// The "getaddrinfo()" error if resolving failed.
+  int get_error() const;
+
+  static void interleave_families(std::vector<SockAddr> &addrs);
+
+ private:
+  struct State {
+    std::atomic_bool done;
+    std::vector<SockAddr> addrs;
+    int error;
+  };
+
+  struct Running {
+    std::mutex mutex;
+    // by "host:port", removed once done
+    std::unordered_map<std::string, std::shared_ptr<State> > lookups;
+  };
+
+  // Shared with the resolving thread, which may outlive this object.
+  std::shared_ptr<State> state;
+
+  /// Lookups still running, of every HostResolver. Never destroyed, as
+  /// detached threads may still use it at exit.
+  static Running &running();
+};
+
+#endif
@@ -0,0 +1,513 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "io_uring_socket.h"
+
+// Standard library includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+// Unix includes
+#ifdef MPD_INFO_SCREEN_2_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert((MPD_CLI_URING_RECV_BUF_COUNT &
+               (MPD_CLI_URING_RECV_BUF_COUNT - 1)) == 0,
+              "MPD_CLI_URING_RECV_BUF_COUNT must be a power of two!");
+
+#ifdef MPD_INFO_SCREEN_2_IO_URING
+namespace {
+
+// "user_data" of the requests, to tell their completions apart.
+constexpr uint64_t URING_SEND = 1;
+constexpr uint64_t URING_RECV = 2;
+constexpr uint64_t URING_CANCEL = 3;
+
+constexpr uint16_t URING_BUF_GROUP = 0;
+constexpr unsigned URING_SQ_ENTRIES = 4;
+// Room for a completion per receive buffer, plus the send and the cancel.
+constexpr unsigned URING_CQ_ENTRIES = 2 * MPD_CLI_URING_RECV_BUF_COUNT;
+
+uint32_t load_acquire(uint32_t *ptr) {
+  return std::atomic_ref<uint32_t>(*ptr).load(std::memory_order_acquire);
+}
+
+void store_release(uint32_t *ptr, uint32_t value) {
+  std::atomic_ref<uint32_t>(*ptr).store(value, std::memory_order_release);
+}
+
+}  // namespace
+#endif
+
+IoUringSocket::IoUringSocket()
+    : ring_fd(-1),
+      sock_fd(-1),
+      ring_mem(nullptr),
+      ring_mem_size(0),
+      sqes(nullptr),
+      sqes_size(0),
+      cqes(nullptr),
+      sq_tail(nullptr),
+      cq_head(nullptr),
+      cq_tail(nullptr),
+      sq_mask(0),
+      cq_mask(0),
+      sq_local_tail(0),
+      sq_pending(0),
+      buf_ring(nullptr),
+      buf_ring_tail(0),
+      recv_bufs(),
+      recv_bufs_free(0),
+      chunks(),
+      chunks_head(0),
+      chunks_count(0),
+      chunk_offset(0),
+      recv_armed(false),
+      recv_status(0),
+      send_buf(),
+      send_in_flight(false),
+      send_result() {}
+
+IoUringSocket::~IoUringSocket() { close(); }
+
+IoUringSocket::IoUringSocket(IoUringSocket &&other)
+    : ring_fd(other.ring_fd),
+      sock_fd(other.sock_fd),
+      ring_mem(other.ring_mem),
+      ring_mem_size(other.ring_mem_size),
+      sqes(other.sqes),
+      sqes_size(other.sqes_size),
+      cqes(other.cqes),
+      sq_tail(other.sq_tail),
+      cq_head(other.cq_head),
+      cq_tail(other.cq_tail),
+      sq_mask(other.sq_mask),
+      cq_mask(other.cq_mask),
+      sq_local_tail(other.sq_local_tail),
+      sq_pending(other.sq_pending),
+      buf_ring(other.buf_ring),
+      buf_ring_tail(other.buf_ring_tail),
+      recv_bufs(std::move(other.recv_bufs)),
+      recv_bufs_free(other.recv_bufs_free),
+      chunks(other.chunks),
+      chunks_head(other.chunks_head),
+      chunks_count(other.chunks_count),
+      chunk_offset(other.chunk_offset),
+      recv_armed(other.recv_armed),
+      recv_status(other.recv_status),
+      send_buf(std::move(other.send_buf)),
+      send_in_flight(other.send_in_flight),
+      send_result(other.send_result) {
+  other.ring_fd = -1;
+  other.ring_mem = nullptr;
+  other.sqes = nullptr;
+  other.buf_ring = nullptr;
+}
+
+IoUringSocket &IoUringSocket::operator=(IoUringSocket &&other) {
+  close();
+
+  this->ring_fd = other.ring_fd;
+  other.ring_fd = -1;
+  this->sock_fd = other.sock_fd;
+  this->ring_mem = other.ring_mem;
+  other.ring_mem = nullptr;
+  this->ring_mem_size = other.ring_mem_size;
+  this->sqes = other.sqes;
+  other.sqes = nullptr;
+  this->sqes_size = other.sqes_size;
+  this->cqes = other.cqes;
+  this->sq_tail = other.sq_tail;
+  this->cq_head = other.cq_head;
+  this->cq_tail = other.cq_tail;
+  this->sq_mask = other.sq_mask;
+  this->cq_mask = other.cq_mask;
+  this->sq_local_tail = other.sq_local_tail;
+  this->sq_pending = other.sq_pending;
+  this->buf_ring = other.buf_ring;
+  other.buf_ring = nullptr;
+  this->buf_ring_tail = other.buf_ring_tail;
+  this->recv_bufs = std::move(other.recv_bufs);
+  this->recv_bufs_free = other.recv_bufs_free;
+  this->chunks = other.chunks;
+  this->chunks_head = other.chunks_head;
+  this->chunks_count = other.chunks_count;
+  this->chunk_offset = other.chunk_offset;
+  this->recv_armed = other.recv_armed;
+  this->recv_status = other.recv_status;
+  this->send_buf = std::move(other.send_buf);
+  this->send_in_flight = other.send_in_flight;
+  this->send_result = other.send_result;
+
+  return *this;
+}
+
+bool IoUringSocket::is_open() const { return ring_fd >= 0; }
+
+int IoUringSocket::get_fd() const { return ring_fd; }
+
+bool IoUringSocket::is_sending() const { return send_in_flight; }
+
+std::optional<int> IoUringSocket::take_send_result() {
+  reap();
+  return std::exchange(send_result, std::nullopt);
+}
+
+std::string_view IoUringSocket::received() {
+  if (!is_open()) {
+    return {};
+  }
+
+  reap();
+  rearm_recv();
+  if (chunks_count == 0) {
+    return {};
+  }
+
+  const Chunk &chunk = chunks[chunks_head];
+  return std::string_view(
+      recv_bufs.get() + chunk.buf_id * MPD_CLI_URING_RECV_BUF_SIZE +
+          chunk_offset,
+      chunk.size - chunk_offset);
+}
+
+void IoUringSocket::consume(size_t count) {
+  while (count > 0 && chunks_count > 0) {
+    const Chunk &chunk = chunks[chunks_head];
+    size_t consumed = std::min(count, chunk.size - chunk_offset);
+    chunk_offset += consumed;
+    count -= consumed;
+    if (chunk_offset == chunk.size) {
+      recycle(chunk.buf_id);
+      chunks_head = (chunks_head + 1) % MPD_CLI_URING_RECV_BUF_COUNT;
+      --chunks_count;
+      chunk_offset = 0;
+    }
+  }
+  // Nothing may be in flight to wake up "poll()" until this is submitted.
+  rearm_recv();
+}
+
+bool IoUringSocket::has_received() const { return chunks_count > 0; }
+
+int IoUringSocket::get_recv_status() const { return recv_status; }
+
+void IoUringSocket::rearm_recv() {
+  if (!recv_armed && recv_status > 0 && recv_bufs_free > 0) {
+    if (!queue_recv() || !submit(0)) {
+      recv_status = -errno;
+    }
+  }
+}
+
+#ifdef MPD_INFO_SCREEN_2_IO_URING
+bool IoUringSocket::is_built() { return true; }
+
+bool IoUringSocket::open(int fd) {
+  close();
+
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(struct io_uring_params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = URING_CQ_ENTRIES;
+  int ret = static_cast<int>(
+      syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params));
+  if (ret < 0) {
+    return false;
+  }
+  ring_fd = ret;
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(params.features & IORING_FEAT_NODROP)) {
+    close();
+    return false;
+  }
+
+  ring_mem_size = std::max(
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+  ring_mem = mmap(nullptr, ring_mem_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (ring_mem == MAP_FAILED) {
+    ring_mem = nullptr;
+    close();
+    return false;
+  }
+  sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes_mem = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes_mem == MAP_FAILED) {
+    close();
+    return false;
+  }
+  sqes = static_cast<struct io_uring_sqe *>(sqes_mem);
+
+  char *base = static_cast<char *>(ring_mem);
+  sq_tail = reinterpret_cast<uint32_t *>(base + params.sq_off.tail);
+  sq_mask = *reinterpret_cast<uint32_t *>(base + params.sq_off.ring_mask);
+  uint32_t *sq_array = reinterpret_cast<uint32_t *>(base + params.sq_off.array);
+  for (uint32_t idx = 0; idx <= sq_mask; ++idx) {
+    sq_array[idx] = idx;
+  }
+  cq_head = reinterpret_cast<uint32_t *>(base + params.cq_off.head);
+  cq_tail = reinterpret_cast<uint32_t *>(base + params.cq_off.tail);
+  cq_mask = *reinterpret_cast<uint32_t *>(base + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<struct io_uring_cqe *>(base + params.cq_off.cqes);
+  sq_local_tail = *sq_tail;
+  sq_pending = 0;
+
+  // The buffer ring must be page aligned.
+  void *buf_ring_mem =
+      mmap(nullptr, MPD_CLI_URING_RECV_BUF_COUNT * sizeof(struct io_uring_buf),
+           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf_ring_mem == MAP_FAILED) {
+    close();
+    return false;
+  }
+  buf_ring = buf_ring_mem;
+  buf_ring_tail = 0;
+  if (!recv_bufs) {
+    recv_bufs = std::make_unique_for_overwrite<char[]>(
+        MPD_CLI_URING_RECV_BUF_COUNT * MPD_CLI_URING_RECV_BUF_SIZE);
+  }
+  recv_bufs_free = 0;
+  for (uint16_t idx = 0; idx < MPD_CLI_URING_RECV_BUF_COUNT; ++idx) {
+    recycle(idx);
+  }
+  struct io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+  reg.ring_entries = MPD_CLI_URING_RECV_BUF_COUNT;
+  reg.bgid = URING_BUF_GROUP;
+  if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING,
+              &reg, 1) != 0) {
+    close();
+    return false;
+  }
+
+  if (!send_buf) {
+    send_buf = std::make_unique_for_overwrite<char[]>(
+        MPD_CLI_URING_SEND_BUF_SIZE);
+  }
+  sock_fd = fd;
+  chunks_head = 0;
+  chunks_count = 0;
+  chunk_offset = 0;
+  recv_status = 1;
+  send_in_flight = false;
+  send_result.reset();
+  if (!queue_recv() || !submit(0)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void IoUringSocket::close() {
+  if (ring_fd < 0) {
+    return;
+  }
+
+  if (recv_armed || send_in_flight) {
+    // The buffers must not be written to by the kernel once freed, so wait
+    // for everything in flight to be cancelled.
+    recv_status = -ECANCELED;
+    struct io_uring_sqe *sqe = next_sqe();
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      sqe->user_data = URING_CANCEL;
+    }
+    while ((recv_armed || send_in_flight) && submit(1)) {
+      reap();
+    }
+  }
+
+  if (buf_ring) {
+    munmap(buf_ring,
+           MPD_CLI_URING_RECV_BUF_COUNT * sizeof(struct io_uring_buf));
+    buf_ring = nullptr;
+  }
+  if (sqes) {
+    munmap(sqes, sqes_size);
+    sqes = nullptr;
+  }
+  if (ring_mem) {
+    munmap(ring_mem, ring_mem_size);
+    ring_mem = nullptr;
+  }
+  ::close(ring_fd);
+  ring_fd = -1;
+  sock_fd = -1;
+  recv_armed = false;
+  recv_status = 0;
+  send_in_flight = false;
+  send_result.reset();
+  chunks_count = 0;
+}
+
+bool IoUringSocket::start_send(std::string_view data) {
+  if (!is_open() || send_in_flight) {
+    return false;
+  }
+
+  struct io_uring_sqe *sqe = next_sqe();
+  if (!sqe) {
+    errno = EBUSY;
+    return false;
+  }
+  // Copied, so that the kernel never reads memory the caller reuses.
+  const size_t size = std::min(data.size(), MPD_CLI_URING_SEND_BUF_SIZE);
+  std::memcpy(send_buf.get(), data.data(), size);
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = sock_fd;
+  sqe->addr = reinterpret_cast<uint64_t>(send_buf.get());
+  sqe->len = static_cast<uint32_t>(size);
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = URING_SEND;
+  send_in_flight = true;
+  send_result.reset();
+  return submit(0);
+}
+
+void IoUringSocket::reap() {
+  if (!is_open()) {
+    return;
+  }
+
+  uint32_t head = *cq_head;
+  const uint32_t tail = load_acquire(cq_tail);
+  for (; head != tail; ++head) {
+    const struct io_uring_cqe &cqe = cqes[head & cq_mask];
+    if (cqe.user_data == URING_SEND) {
+      send_in_flight = false;
+      send_result = cqe.res;
+    } else if (cqe.user_data == URING_RECV) {
+      if (cqe.flags & IORING_CQE_F_BUFFER) {
+        const uint16_t buf_id =
+            static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        --recv_bufs_free;
+        if (cqe.res > 0) {
+          chunks[(chunks_head + chunks_count) % MPD_CLI_URING_RECV_BUF_COUNT] =
+              Chunk{buf_id, static_cast<uint32_t>(cqe.res)};
+          ++chunks_count;
+        } else {
+          recycle(buf_id);
+        }
+      }
+      if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        // The multishot receive ended. Running out of buffers is not an
+        // error, it is submitted again once buffers are consumed.
+        recv_armed = false;
+        if (recv_status > 0 && cqe.res <= 0 && cqe.res != -ENOBUFS) {
+          recv_status = cqe.res;
+        }
+      }
+    }
+  }
+  store_release(cq_head, head);
+}
+
+struct io_uring_sqe *IoUringSocket::next_sqe() {
+  if (sq_pending > sq_mask) {
+    return nullptr;
+  }
+
+  struct io_uring_sqe *sqe = &sqes[sq_local_tail & sq_mask];
+  std::memset(sqe, 0, sizeof(struct io_uring_sqe));
+  ++sq_local_tail;
+  ++sq_pending;
+  return sqe;
+}
+
+bool IoUringSocket::submit(unsigned wait_count) {
+  if (sq_pending == 0 && wait_count == 0) {
+    return true;
+  }
+
+  store_release(sq_tail, sq_local_tail);
+  long ret;
+  do {
+    ret = syscall(__NR_io_uring_enter, ring_fd, sq_pending, wait_count,
+                  wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) {
+    return false;
+  }
+  sq_pending -= std::min(static_cast<uint32_t>(ret), sq_pending);
+  return true;
+}
+
+bool IoUringSocket::queue_recv() {
+  struct io_uring_sqe *sqe = next_sqe();
+  if (!sqe) {
+    errno = EBUSY;
+    return false;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = sock_fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUF_GROUP;
+  sqe->user_data = URING_RECV;
+  recv_armed = true;
+  return true;
+}
+
+void IoUringSocket::recycle(uint16_t buf_id) {
+  // The kernel header's "io_uring_buf_ring" doesn't have the right layout
+  // in C++, the ring is an array of "io_uring_buf" with the tail in the
+  // "resv" of the first one.
+  struct io_uring_buf *entries = static_cast<struct io_uring_buf *>(buf_ring);
+  struct io_uring_buf &entry =
+      entries[buf_ring_tail & (MPD_CLI_URING_RECV_BUF_COUNT - 1)];
+  entry.addr = reinterpret_cast<uint64_t>(
+      recv_bufs.get() + buf_id * MPD_CLI_URING_RECV_BUF_SIZE);
+  entry.len = static_cast<uint32_t>(MPD_CLI_URING_RECV_BUF_SIZE);
+  entry.bid = buf_id;
+  ++buf_ring_tail;
+  std::atomic_ref<uint16_t>(entries[0].resv)
+      .store(buf_ring_tail, std::memory_order_release);
+  ++recv_bufs_free;
+}
+#else
+// Without io_uring support the ring never opens, and the socket is used
+// directly.
+bool IoUringSocket::is_built() { return false; }
+
+bool IoUringSocket::open(int) { return false; }
+
+void IoUringSocket::close() {}
+
+bool IoUringSocket::start_send(std::string_view) { return false; }
+
+void IoUringSocket::reap() {}
+
+io_uring_sqe *IoUringSocket::next_sqe() { return nullptr; }
+
+bool IoUringSocket::submit(unsigned) { return false; }
+
+bool IoUringSocket::queue_recv() { return false; }
+
+void IoUringSocket::recycle(uint16_t) {}
+#endif
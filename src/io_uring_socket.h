@@ -0,0 +1,137 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_IO_URING_SOCKET_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_IO_URING_SOCKET_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// local includes
+#include "constants.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/// Sends on and receives from a connected socket through io_uring, with
+/// fewer system calls than "send()"/"recv()" on the non-blocking socket. One
+/// multishot receive fills a ring of provided buffers without being
+/// submitted again, and completions are picked up from memory shared with
+/// the kernel. Only works if built with MPD_INFO_SCREEN_2_IO_URING,
+/// otherwise "open()" fails and the socket is to be used directly.
+class IoUringSocket {
+ public:
+  IoUringSocket();
+  ~IoUringSocket();
+
+  // No copy
+  IoUringSocket(const IoUringSocket &) = delete;
+  IoUringSocket &operator=(const IoUringSocket &) = delete;
+
+  // Allow move
+  IoUringSocket(IoUringSocket &&);
+  IoUringSocket &operator=(IoUringSocket &&);
+
+  /// True if built with io_uring support.
+  static bool is_built();
+
+  /// Sets up the ring for the connected socket "fd" and starts receiving
+  /// from it. Returns false if io_uring can't be used.
+  bool open(int fd);
+  /// Cancels what is in flight and tears down the ring. Doesn't close the
+  /// socket.
+  void close();
+  bool is_open() const;
+  /// Readable once a completion arrived, to "poll()" instead of the socket.
+  int get_fd() const;
+
+  /// Starts sending the front of "data" (as much as fits the send buffer),
+  /// unless a send is in flight. Returns false if it couldn't be submitted.
+  bool start_send(std::string_view data);
+  bool is_sending() const;
+  /// The result of the send that finished, like the return value of
+  /// "send()" but with a negative errno on failure. Empty while the send is
+  /// in flight, or if none was started.
+  std::optional<int> take_send_result();
+
+  /// The front of the data received and not consumed yet, empty if none.
+  std::string_view received();
+  /// Consumes "count" bytes from the front of "received()".
+  void consume(size_t count);
+  /// True if "received()" has data, without checking for new completions.
+  bool has_received() const;
+  /// Positive while receiving, 0 once the peer closed the connection, or a
+  /// negative errno if receiving failed. Only meaningful once "received()"
+  /// is empty.
+  int get_recv_status() const;
+
+ private:
+  struct Chunk {
+    uint16_t buf_id;
+    uint32_t size;
+  };
+
+  /// Moves the completions that arrived into the state below.
+  void reap();
+  /// Returns nullptr if the submission queue is full.
+  io_uring_sqe *next_sqe();
+  /// Submits the queued entries, and waits for "wait_count" completions.
+  bool submit(unsigned wait_count);
+  bool queue_recv();
+  /// Submits the receive again if it stopped, likely because every buffer
+  /// was in use, and buffers were given back since.
+  void rearm_recv();
+  /// Gives buffer "buf_id" back to the kernel to receive into.
+  void recycle(uint16_t buf_id);
+
+  int ring_fd;
+  int sock_fd;
+  // shared with the kernel
+  void *ring_mem;
+  size_t ring_mem_size;
+  io_uring_sqe *sqes;
+  size_t sqes_size;
+  io_uring_cqe *cqes;
+  uint32_t *sq_tail;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t sq_mask;
+  uint32_t cq_mask;
+  // entries queued since the last "submit()"
+  uint32_t sq_local_tail;
+  uint32_t sq_pending;
+  // provided buffer ring, and the buffers it hands out
+  void *buf_ring;
+  uint16_t buf_ring_tail;
+  std::unique_ptr<char[]> recv_bufs;
+  size_t recv_bufs_free;
+  // received buffers in arrival order
+  std::array<Chunk, MPD_CLI_URING_RECV_BUF_COUNT> chunks;
+  size_t chunks_head;
+  size_t chunks_count;
+  size_t chunk_offset;
+  bool recv_armed;
+  int recv_status;
+  std::unique_ptr<char[]> send_buf;
+  bool send_in_flight;
+  std::optional<int> send_result;
+};
+
+#endif
@@ -20,8 +20,10 @@
 #include "helpers.h"
 #include "host_prompt.h"
 #include "mpd_client.h"
+#include "mpd_client_thread.h"
 #include "mpd_display.h"
 #include "print_helper.h"
+#include "protocol_trace.h"
 #include "signal_handler.h"
 #include "version.h"
 
@@ -29,6 +31,7 @@
 #include <atomic>
 #include <chrono>
 #include <fstream>
+#include <memory>
 #include <optional>
 
 // third-party includes
@@ -93,7 +96,8 @@ int main(int argc, char **argv) {
   MPDClient cli(args.is_using_unix_socket() ? args.get_host_unix_socket()
                                             : args.get_host_ip_addr(),
                 args.get_host_port(), args.get_log_level(),
-                args.is_using_unix_socket());
+                args.is_using_unix_socket(), args.get_connect_timeout(),
+                args.get_heartbeat_interval());
 
   if (!cli.is_ok()) {
     LOG_PRINT(args.get_log_level(), LogLevel::VERBOSE,
@@ -103,12 +107,39 @@ int main(int argc, char **argv) {
     LOG_PRINT(args.get_log_level(), LogLevel::VERBOSE, "VERBOSE: Client is OK");
   }
 
+  if (args.get_trace_file().has_value()) {
+    auto trace =
+        std::make_shared<ProtocolTrace>(args.get_trace_file().value());
+    if (!trace->is_ok()) {
+      LOG_PRINT(args.get_log_level(), LogLevel::ERROR,
+                "ERROR: Failed to open \"{}\" to record the trace!",
+                args.get_trace_file().value());
+      return 1;
+    }
+    cli.set_trace(std::move(trace));
+  }
+
+  // From here on the client only runs on its own thread.
+  MPDClientThread net(std::move(cli),
+                      args.is_using_unix_socket() ? args.get_host_unix_socket()
+                                                  : args.get_host_ip_addr(),
+                      args.get_host_port(), args.get_log_level(),
+                      args.is_using_unix_socket(), args.get_connect_timeout(),
+                      args.get_heartbeat_interval());
+
   std::optional<MPDDisplay> disp(std::in_place, args.get_flags(),
                                  args.get_log_level());
 
   int set_fps = TARGET_FPS;
 
-  const auto do_auth = [&args, &cli, &disp, &set_fps]() {
+  // Auth attempts are made on the network thread, results arrive in a later
+  // snapshot.
+  bool auth_pending = false;
+  bool auth_from_prompt = false;
+  uint64_t seen_auth_attempts = 0;
+
+  const auto do_auth = [&args, &net, &disp, &set_fps, &auth_pending,
+                        &auth_from_prompt]() {
     if (args.get_password_file().has_value()) {
       LOG_PRINT(args.get_log_level(), LogLevel::VERBOSE,
                 "VERBOSE: Attempting login...");
@@ -129,21 +160,15 @@ int main(int argc, char **argv) {
           }
         }
       }
-      if (!cli.attempt_auth(passwd)) {
-        disp->set_failed_auth();
-      }
+      net.attempt_auth(std::move(passwd));
+      auth_pending = true;
+      auth_from_prompt = false;
     } else {
       auto fetched_pass = disp->fetch_prompted_pass();
       if (fetched_pass.has_value()) {
-        if (!cli.attempt_auth(fetched_pass.value())) {
-          disp->request_password_prompt();
-        } else {
-          if (set_fps != TARGET_FPS) {
-            SetTargetFPS(TARGET_FPS);
-            set_fps = TARGET_FPS;
-          }
-          disp->clear_cached_pass();
-        }
+        net.attempt_auth(std::move(fetched_pass.value()));
+        auth_pending = true;
+        auth_from_prompt = true;
         LOG_PRINT(args.get_log_level(), LogLevel::VERBOSE,
                   "VERBOSE: Login attempted.");
       } else {
@@ -161,38 +186,35 @@ int main(int argc, char **argv) {
 
   register_signals();
 
-  auto update_time_point = std::chrono::steady_clock::now();
 #ifndef NDEBUG
   auto print_info_time_point = std::chrono::steady_clock::now();
 #endif
-  std::optional<decltype(update_time_point)> reconnect_time_point =
+  std::optional<std::chrono::steady_clock::time_point> reconnect_time_point =
       std::nullopt;
 
   std::optional<std::string> message;
 
   int reconnect_attempts = 0;
+  uint64_t generation = 0;
 
   while (!WindowShouldClose() &&
          !IS_SIGNAL_HANDLED.load(std::memory_order_relaxed)) {
     // update
+    // The network thread publishes a snapshot whenever MPDClient updates.
+    net.fetch_snapshot();
+    const MPDSnapshot &snap = net.get_snapshot();
     auto new_time_point = std::chrono::steady_clock::now();
 
-    if (new_time_point - update_time_point > UPDATE_INFO_INTERVAL) {
-      cli.request_data_update();
-      update_time_point = new_time_point;
-    }
 #ifndef NDEBUG
     if (new_time_point - print_info_time_point > DEBUG_PRINT_INFO_INTERVAL) {
       LOG_PRINT(
           args.get_log_level(), LogLevel::DEBUG,
           "Title: {}\nArtist: {}\nAlbum: {}\nFilename: {}\nDuration: "
           "{}\nElapsed: {}\nAlbumArtSize: {}\nAlbumArtMimeType: {}",
-          cli.get_song_title(), cli.get_song_artist(), cli.get_song_album(),
-          cli.get_song_filename(), cli.get_song_duration(),
-          std::get<double>(cli.get_elapsed_time()),
-          cli.get_album_art().has_value() ? cli.get_album_art().value().size()
-                                          : 0,
-          cli.get_album_art_mime_type());
+          snap.song_title, snap.song_artist, snap.song_album,
+          snap.song_filename, snap.song_duration, snap.elapsed_time,
+          snap.album_art ? snap.album_art->size() : 0,
+          snap.album_art_mime_type);
       print_info_time_point = new_time_point;
     }
 #endif
@@ -201,28 +223,21 @@ int main(int argc, char **argv) {
       disp->request_reposition_texture(args);
     }
 
-    if (!cli.is_ok() &&
-        (cli.ping_success() || reconnect_attempts < MAX_RECONNECT_ATTEMPTS)) {
+    if (snap.generation != generation) {
+      // Still showing the client from before "reconnect()".
+    } else if (!snap.is_ok && (snap.ping_success ||
+                               reconnect_attempts < MAX_RECONNECT_ATTEMPTS)) {
       if (reconnect_time_point.has_value()) {
         if (new_time_point - reconnect_time_point.value() >
             RECONNECT_INTERVAL) {
           reconnect_time_point = std::nullopt;
-          cli = MPDClient(args.is_using_unix_socket()
-                              ? args.get_host_unix_socket()
-                              : args.get_host_ip_addr(),
-                          args.get_host_port(), args.get_log_level(),
-                          args.is_using_unix_socket());
+          generation = net.reconnect();
           disp.emplace(args.get_flags(), args.get_log_level());
-
-          // Force an update on MPDClient to attempt a connection.
-          cli.update();
-          if (cli.ping_success()) {
-            reconnect_attempts = 0;
-          }
+          auth_pending = false;
         }
       } else {
         reconnect_time_point = new_time_point;
-        if (cli.ping_success()) {
+        if (snap.ping_success) {
           reconnect_attempts = 0;
           message.reset();
         } else {
@@ -237,26 +252,48 @@ int main(int argc, char **argv) {
           message = std::format("connection attempt {}...", reconnect_attempts);
         }
       }
-    } else if (!cli.is_ok() && reconnect_attempts >= MAX_RECONNECT_ATTEMPTS) {
+    } else if (!snap.is_ok && reconnect_attempts >= MAX_RECONNECT_ATTEMPTS) {
       LOG_PRINT(LogLevel::ERROR, LogLevel::ERROR,
                 "ERROR: Failed to reconnect after {} attempts, stopping...",
                 MAX_RECONNECT_ATTEMPTS);
       break;
-    } else if (cli.is_ok() && message) {
-      message.reset();
+    } else if (snap.is_ok) {
+      if (snap.ping_success) {
+        reconnect_attempts = 0;
+      }
+      // Keep showing the attempt count until the connect finishes.
+      if (!snap.is_connecting) {
+        message.reset();
+      }
     }
 
-    cli.update();
-    if (cli.needs_auth()) {
+    if (snap.auth_attempts != seen_auth_attempts) {
+      seen_auth_attempts = snap.auth_attempts;
+      auth_pending = false;
+      if (!auth_from_prompt) {
+        if (snap.auth_failed) {
+          disp->set_failed_auth();
+        }
+      } else if (snap.auth_failed) {
+        disp->request_password_prompt();
+      } else {
+        if (set_fps != TARGET_FPS) {
+          SetTargetFPS(TARGET_FPS);
+          set_fps = TARGET_FPS;
+        }
+        disp->clear_cached_pass();
+      }
+    }
+    if (snap.needs_auth && !auth_pending && snap.generation == generation) {
       message.reset();
       do_auth();
     }
-    disp->update(cli, args);
+    disp->update(snap, net, args);
 
     // draw
     BeginDrawing();
     ClearBackground(CLEAR_BG_COLOR);
-    disp->draw(cli, args);
+    disp->draw(snap, args);
     if (message) {
       DrawRectangle(0, 20, GetScreenWidth(), 20, BLACK);
       DrawText(message->c_str(), 0, 20, 20, WHITE);
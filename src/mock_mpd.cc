@@ -0,0 +1,332 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "mock_mpd.h"
+
+// Standard library includes
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <thread>
+
+// Unix includes
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+bool wait_readable(int fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, timeout_ms) > 0;
+}
+
+}  // namespace
+
+MockMPD::MockMPD(const std::string &path)
+    : send_change(false),
+      stop(false),
+      song_info_sent(0),
+      status_sent(0),
+      song_info_lists_received(0),
+      changes(0),
+      connections(0),
+      art_chunks_sent(0),
+      art_lists_received(0),
+      art_bytes_sent(0),
+      readpicture_requests(0),
+      noidle_received(0),
+      play_queue(false),
+      cover_file_only(false),
+      song_without_picture(),
+      art_size(0),
+      art_chunk_size(0),
+      short_second_chunk(false),
+      drop_after_chunks(0),
+      art_delay(0),
+      reply_delay(0),
+      bytes_per_second(0),
+      fail_command(),
+      max_connections(0),
+      password(),
+      art(),
+      listen_fd(-1) {
+  unlink(path.c_str());
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(),
+              std::min(path.size() + 1, sizeof(addr.sun_path) - 1));
+  bind(listen_fd, reinterpret_cast<const struct sockaddr *>(&addr),
+       sizeof(addr));
+  listen(listen_fd, 4);
+}
+
+MockMPD::~MockMPD() { close(listen_fd); }
+
+void MockMPD::run() {
+  art = generated_art();
+  std::vector<std::thread> threads;
+  while (!stop.load()) {
+    if (send_change.exchange(false)) {
+      ++changes;
+    }
+    if (!wait_readable(listen_fd, 1)) {
+      continue;
+    }
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    } else if (max_connections != 0 && connections.load() >= max_connections) {
+      close(fd);
+      continue;
+    }
+    ++connections;
+    threads.emplace_back(&MockMPD::serve, this, fd);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+std::string MockMPD::generated_art() const {
+  std::string art(art_size, '\0');
+  for (size_t idx = 0; idx < art.size(); ++idx) {
+    art[idx] = static_cast<char>(idx * 7);
+  }
+  return art;
+}
+
+void MockMPD::serve(int fd) {
+  Connection conn;
+  conn.out = "OK MPD 0.24.0\n";
+  conn.binary_limit = 8192;
+  conn.seen_changes = changes.load();
+  conn.authed = password.empty();
+  conn.idling = false;
+  conn.dropped = false;
+
+  std::string buf;
+  std::vector<std::string> list_lines;
+  bool in_list = false;
+  char read_buf[4096];
+  while (!stop.load()) {
+    if (conn.idling && changes.load() != conn.seen_changes) {
+      conn.seen_changes = changes.load();
+      conn.out.append("changed: player\nOK\n");
+      conn.idling = false;
+    }
+    if (!conn.out.empty()) {
+      std::this_thread::sleep_for(reply_delay);
+      if (!send_all(fd, conn.out)) {
+        break;
+      }
+      conn.out.clear();
+    }
+    if (conn.dropped) {
+      break;
+    } else if (!wait_readable(fd, 1)) {
+      continue;
+    }
+    ssize_t read_ret = recv(fd, read_buf, sizeof(read_buf), 0);
+    if (read_ret <= 0) {
+      break;
+    }
+    buf.append(read_buf, static_cast<size_t>(read_ret));
+
+    size_t newline_idx;
+    while (!conn.dropped &&
+           (newline_idx = buf.find('\n')) != std::string::npos) {
+      std::string line = buf.substr(0, newline_idx);
+      buf.erase(0, newline_idx + 1);
+      if (line == "command_list_ok_begin") {
+        in_list = true;
+      } else if (line == "command_list_end") {
+        in_list = false;
+        if (!list_lines.empty() &&
+            (list_lines[0].starts_with("readpicture") ||
+             list_lines[0].starts_with("albumart"))) {
+          ++art_lists_received;
+        } else if (std::find(list_lines.begin(), list_lines.end(),
+                             "currentsong") != list_lines.end()) {
+          ++song_info_lists_received;
+        }
+        bool ok = true;
+        for (const std::string &list_line : list_lines) {
+          if (!(ok = reply(conn, list_line, true))) {
+            break;
+          }
+          conn.out.append("list_OK\n");
+        }
+        if (ok) {
+          conn.out.append("OK\n");
+        }
+        list_lines.clear();
+      } else if (in_list) {
+        list_lines.push_back(line);
+      } else if (line.starts_with("idle")) {
+        conn.idling = true;
+      } else if (line == "noidle") {
+        ++noidle_received;
+        if (conn.idling) {
+          conn.out.append("OK\n");
+          conn.idling = false;
+        }
+      } else if (reply(conn, line, false)) {
+        conn.out.append("OK\n");
+      }
+    }
+  }
+  close(fd);
+}
+
+bool MockMPD::reply(Connection &conn, const std::string &line,
+                    bool in_list) {
+  std::string name = line.substr(0, line.find(' '));
+  if (!fail_command.empty() && name == fail_command) {
+    conn.out.append(std::format("ACK [5@0] {{{}}} injected error\n", name));
+    return false;
+  } else if (name == "password") {
+    conn.authed = line == std::format("password \"{}\"", password);
+    if (!conn.authed) {
+      conn.out.append("ACK [3@0] {password} incorrect password\n");
+    }
+    return conn.authed;
+  } else if (!conn.authed &&
+             (name == "status" || name == "currentsong" ||
+              name == "playlistid" || name == "readpicture" ||
+              name == "albumart")) {
+    conn.out.append(
+        std::format("ACK [4@0] {{{}}} you don't have permission\n", name));
+    return false;
+  }
+
+  uint64_t song_id = changes.load() + 1;
+  if (name == "binarylimit") {
+    conn.binary_limit = std::stoull(line.substr(12));
+  } else if (name == "status") {
+    if (play_queue) {
+      conn.out.append(std::format(
+          "state: play\nsongid: {}\nnextsongid: {}\nplaylist: 2\n", song_id,
+          song_id + 1));
+    } else {
+      // The song doesn't change.
+      conn.out.append(
+          "state: play\nsongid: 1\nplaylist: 2\nelapsed: 12.5\n"
+          "duration: 200.0\n");
+    }
+    if (!in_list) {
+      ++status_sent;
+    }
+  } else if (name == "currentsong") {
+    if (play_queue) {
+      conn.out.append(
+          std::format("file: {}\nTitle: Title\n", song_file(song_id)));
+    } else {
+      conn.out.append(
+          "file: dir/a.flac\nTitle: Title\nArtist: Artist\nAlbum: Album\n");
+    }
+    ++song_info_sent;
+  } else if (name == "playlistid" && play_queue) {
+    conn.out.append(std::format("file: {}\nTitle: Next\n",
+                                song_file(std::stoull(line.substr(11)))));
+  } else if (name == "readpicture" && serves_art() &&
+             (cover_file_only || quoted_file(line) == song_without_picture)) {
+    // MPD replies with an empty "OK" if there is no embedded picture.
+    ++readpicture_requests;
+  } else if ((name == "readpicture" || name == "albumart") && serves_art() &&
+             (name == "albumart") == cover_file_only) {
+    std::string chunk = picture_chunk(conn, line);
+    if (conn.dropped) {
+      return false;
+    }
+    conn.out.append(chunk);
+  } else if (name == "readpicture" || name == "albumart") {
+    conn.out.append(
+        std::format("ACK [50@0] {{{}}} No file exists\n", name));
+    return false;
+  }
+  return true;
+}
+
+bool MockMPD::serves_art() const { return play_queue || art_size != 0; }
+
+std::string MockMPD::picture_chunk(Connection &conn, const std::string &line) {
+  std::this_thread::sleep_for(art_delay);
+  // Without "art_size", the file name is the picture.
+  std::string file = quoted_file(line);
+  if (cover_file_only) {
+    file = file.substr(0, file.rfind('/')) + "/cover";
+  }
+  const std::string &picture = art_size != 0 ? art : file;
+  size_t offset =
+      std::min<size_t>(std::stoull(line.substr(line.rfind('"') + 1)),
+                       picture.size());
+  size_t chunk_size = conn.binary_limit;
+  uint64_t chunk_count = ++art_chunks_sent;
+  if (art_chunk_size != 0) {
+    chunk_size = art_chunk_size;
+    if (short_second_chunk && chunk_count == 2) {
+      --chunk_size;
+    }
+  }
+  if (drop_after_chunks != 0 && chunk_count == drop_after_chunks + 1) {
+    conn.dropped = true;
+    return std::string();
+  }
+  std::string chunk = picture.substr(offset, chunk_size);
+  art_bytes_sent += chunk.size();
+  return std::format("size: {}\ntype: image/png\nbinary: {}\n{}\n",
+                     picture.size(), chunk.size(), chunk);
+}
+
+bool MockMPD::send_all(int fd, std::string_view data) const {
+  while (!data.empty()) {
+    size_t size = data.size();
+    if (bytes_per_second != 0) {
+      // A hundredth of a second worth at a time.
+      size = std::min(size, std::max<size_t>(bytes_per_second / 100, 1));
+    }
+    ssize_t ret = send(fd, data.data(), size, MSG_NOSIGNAL);
+    if (ret <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(ret));
+    if (bytes_per_second != 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(
+          static_cast<uint64_t>(ret) * 1000000 / bytes_per_second));
+    }
+  }
+  return true;
+}
+
+std::string MockMPD::song_file(uint64_t id) {
+  return id % 2 == 1 ? "dir/a.flac" : "dir/b.flac";
+}
+
+std::string MockMPD::quoted_file(const std::string &line) {
+  size_t first_quote_idx = line.find('"');
+  size_t quote_idx = line.rfind('"');
+  if (first_quote_idx == std::string::npos || quote_idx == first_quote_idx) {
+    return std::string();
+  }
+  return line.substr(first_quote_idx + 1, quote_idx - first_quote_idx - 1);
+}
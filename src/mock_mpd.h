@@ -0,0 +1,126 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_MOCK_MPD_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_MOCK_MPD_H_
+
+// Standard library includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Stands in for MPD on a unix socket, for the unit tests and the benchmark.
+/// Answers "ping", "status", "currentsong", "playlistid", "password",
+/// "binarylimit", "readpicture", "albumart", "idle" and "noidle", alone or
+/// in command lists. Every connection is served by its own thread.
+///
+/// The options are set before "run()". Setting "send_change" makes pending
+/// "idle"s return "changed: player".
+class MockMPD {
+ public:
+  explicit MockMPD(const std::string &path);
+  ~MockMPD();
+
+  // No copy
+  MockMPD(const MockMPD &) = delete;
+  MockMPD &operator=(const MockMPD &) = delete;
+
+  /// Serves connections until "stop" is set.
+  void run();
+
+  /// The picture every song has if "art_size" is set.
+  std::string generated_art() const;
+
+  std::atomic_bool send_change;
+  std::atomic_bool stop;
+  // replies to "currentsong"
+  std::atomic_uint64_t song_info_sent;
+  // replies to "status" outside of a command list
+  std::atomic_uint64_t status_sent;
+  // command lists with "currentsong"
+  std::atomic_uint64_t song_info_lists_received;
+  std::atomic_uint64_t changes;
+  std::atomic_uint64_t connections;
+  std::atomic_uint64_t art_chunks_sent;
+  std::atomic_uint64_t art_lists_received;
+  std::atomic_uint64_t art_bytes_sent;
+  std::atomic_uint64_t readpicture_requests;
+  std::atomic_uint64_t noidle_received;
+
+  // If set, every change plays the next song of a queue alternating between
+  // two songs, and album art is served.
+  bool play_queue;
+  // If set, songs have no embedded picture and album art is only served by
+  // "albumart", the same for every song of a directory.
+  bool cover_file_only;
+  // If not empty, this song has no embedded picture.
+  std::string song_without_picture;
+  // If not 0, every song has an embedded picture of this many bytes, and
+  // album art is served. Otherwise the picture is the song's file name.
+  size_t art_size;
+  // If not 0, album art is sent in chunks of this size instead of the
+  // client's "binarylimit".
+  size_t art_chunk_size;
+  // If set, the second album art chunk is one byte short.
+  bool short_second_chunk;
+  // If not 0, the connection is closed instead of sending the album art chunk
+  // past this many.
+  uint64_t drop_after_chunks;
+  // Delay before every album art chunk.
+  std::chrono::milliseconds art_delay;
+  // Delay before every reply.
+  std::chrono::milliseconds reply_delay;
+  // If not 0, replies are sent at this many bytes per second.
+  size_t bytes_per_second;
+  // If not empty, this command is answered with an ACK.
+  std::string fail_command;
+  // If not 0, connections past this many are closed right away.
+  uint64_t max_connections;
+  // If not empty, song info and album art need this password.
+  std::string password;
+
+ private:
+  struct Connection {
+    std::string out;
+    size_t binary_limit;
+    uint64_t seen_changes;
+    bool authed;
+    bool idling;
+    // the album art chunk past "drop_after_chunks" was requested
+    bool dropped;
+  };
+
+  // "generated_art()", made once by "run()"
+  std::string art;
+  int listen_fd;
+
+  void serve(int fd);
+  /// Appends the reply to "line" to "conn.out", without the final "OK".
+  /// Returns false if it was an ACK, or if the connection is to be dropped.
+  bool reply(Connection &conn, const std::string &line, bool in_list);
+  bool serves_art() const;
+  std::string picture_chunk(Connection &conn, const std::string &line);
+  bool send_all(int fd, std::string_view data) const;
+
+  static std::string song_file(uint64_t id);
+  /// The file name in quotes in "line".
+  static std::string quoted_file(const std::string &line);
+};
+
+#endif
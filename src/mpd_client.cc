@@ -21,28 +21,152 @@
 #include "helpers.h"
 
 // Standard library includes
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <charconv>
 #include <chrono>
 #include <cstring>
-#include <exception>
-#include <thread>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 // Unix includes
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <netdb.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+namespace {
+
+// Keys of "status", "currentsong" and "playlistid" replies that are used.
+enum SongInfoKey : uint8_t {
+  SK_NONE = 0,
+  SK_TITLE,
+  SK_ARTIST,
+  SK_ALBUM,
+  SK_FILE,
+  SK_DURATION,
+  SK_ELAPSED,
+  SK_STATE,
+  SK_SONG_ID,
+  SK_PLAYLIST,
+  SK_NEXT_SONG_ID
+};
+
+struct SongInfoKeyEntry {
+  std::string_view key;
+  SongInfoKey id;
+};
+
+constexpr SongInfoKeyEntry SONG_INFO_KEYS[] = {
+    {"Title", SK_TITLE},       {"Artist", SK_ARTIST},
+    {"Album", SK_ALBUM},       {"file", SK_FILE},
+    {"duration", SK_DURATION}, {"elapsed", SK_ELAPSED},
+    {"state", SK_STATE},       {"songid", SK_SONG_ID},
+    {"playlist", SK_PLAYLIST}, {"nextsongid", SK_NEXT_SONG_ID}};
+
+constexpr size_t SONG_INFO_TABLE_SIZE = 32;
+
+// Looks only at the length and the first and last characters, which tell the
+// keys above apart. MPD sends many other keys, so a matching slot is still
+// compared with the whole key.
+constexpr size_t song_info_key_slot(std::string_view key) {
+  if (key.empty()) {
+    return 0;
+  }
+  return (key.size() * 6 + static_cast<unsigned char>(key.front()) +
+          static_cast<unsigned char>(key.back())) %
+         SONG_INFO_TABLE_SIZE;
+}
+
+constexpr std::array<SongInfoKeyEntry, SONG_INFO_TABLE_SIZE>
+make_song_info_table() {
+  std::array<SongInfoKeyEntry, SONG_INFO_TABLE_SIZE> table{};
+  for (const SongInfoKeyEntry &entry : SONG_INFO_KEYS) {
+    table[song_info_key_slot(entry.key)] = entry;
+  }
+  return table;
+}
+
+constexpr std::array<SongInfoKeyEntry, SONG_INFO_TABLE_SIZE> SONG_INFO_TABLE =
+    make_song_info_table();
+
+constexpr bool song_info_table_is_perfect() {
+  for (const SongInfoKeyEntry &entry : SONG_INFO_KEYS) {
+    if (SONG_INFO_TABLE[song_info_key_slot(entry.key)].id != entry.id) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(song_info_table_is_perfect(),
+              "Two song info keys have the same slot, change "
+              "song_info_key_slot()!");
+
+SongInfoKey song_info_key(std::string_view key) {
+  const SongInfoKeyEntry &entry = SONG_INFO_TABLE[song_info_key_slot(key)];
+  return entry.key == key ? entry.id : SK_NONE;
+}
+
+std::optional<double> parse_double(std::string_view value) {
+  double result = 0.0;
+  if (std::from_chars(value.data(), value.data() + value.size(), result).ec !=
+      std::errc{}) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+// Interrupts "idle", written outside of "write_read()".
+constexpr std::string_view NOIDLE_CMD = "noidle\n";
+
+}  // namespace
+
 MPDClient::MPDClient(std::string host, uint16_t host_port, LogLevel level,
-                     bool is_socket)
-    : flags(),
+                     bool is_socket, std::chrono::milliseconds connect_timeout,
+                     std::chrono::milliseconds heartbeat_interval)
+    : ping_ok(false),
+      status_ok(false),
+      current_song_ok(false),
+      binary_limit_set(false),
+      auth_required(false),
+      auth_pending(false),
+      auth_rejected(false),
+      is_unix_socket(is_socket),
+      is_art_client(false),
+      conn_state(CS_INIT),
+      idle_state(IS_NONE),
+      awaiting_response(false),
+      pending_response(PR_NONE),
+      album_art_needed(false),
+      no_readpicture(false),
+      no_albumart(false),
+      album_art_failed(false),
+      album_art_for_next_song(false),
+      next_song_fetched(false),
+      next_album_art_fetched(false),
+      album_art_on_main(false),
+      album_art_refetch(false),
       level(level),
-      host_ip_value(),
+      host_name(is_socket ? std::string() : host),
       host_port(host_port),
       conn_socket(-1),
+      uring(),
+      use_io_uring(true),
+      uring_sending_noidle(false),
+      resolver(),
+      connect_addrs(),
+      connect_addrs_idx(0),
+      connect_sockets(),
+      connect_attempt_time(std::chrono::steady_clock::now()),
+      connect_errno(0),
       socket_path(is_socket ? host : std::string()),
       song_title(),
       song_artist(),
@@ -52,24 +176,60 @@ MPDClient::MPDClient(std::string host, uint16_t host_port, LogLevel level,
       elapsed_time_point(std::chrono::steady_clock::now()),
       elapsed_time(0.0),
       song_duration(0.0),
+      fetched_album_art(),
+      fetched_album_art_mime_type(),
+      song_id(),
+      status_song_id(),
+      playlist_version(),
+      status_playlist_version(),
+      next_song_id(),
+      status_next_song_id(),
+      next_song_title(),
+      next_song_artist(),
+      next_song_album(),
+      next_song_filename(),
+      next_album_art(),
+      next_album_art_mime_type(),
       album_art(),
-      dummy_album_art_ref(),
       album_art_mime_type(),
       album_art_offset(0),
-      album_art_expected_size(0) {
+      album_art_expected_size(0),
+      album_art_chunk_size(0),
+      album_art_request_offset(0),
+      recv_buf(),
+      response_size(0),
+      parser(),
+      io_deadline(std::chrono::steady_clock::now()),
+      last_heard_time(std::chrono::steady_clock::now()),
+      connect_timeout(connect_timeout),
+      heartbeat_interval(heartbeat_interval),
+      current_command(CMD_NONE),
+      song_info_request(SIR_FULL),
+      status_time(std::chrono::steady_clock::now()),
+      binary_limit(MPD_BINARY_LIMIT),
+      round_trip_time(0),
+      bytes_per_second(0.0),
+      request_time(),
+      request_latency(0),
+      request_bytes(0),
+      request_chunks(0),
+      art_client(),
+      art_client_retry_time(std::chrono::steady_clock::now()),
+      password(),
+      auth_password(),
+      album_art_filename(),
+      partial_album_art(),
+      art_cache(std::make_shared<AlbumArtCache>()),
+      trace(),
+      trace_connection(0) {
   if (is_socket) {
-    flags.set(1);
-    flags.set(8);
-    flags.set(12);
+    album_art_needed = true;
   } else {
-    host_ip_value = helper_ipv4_str_to_value(host);
-    if (!host_ip_value.has_value()) {
-      LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to parse ipv4 \"{}\"!",
-                host);
-      flags.set(0);
+    if (!HostResolver::is_valid_host(host)) {
+      LOG_PRINT(level, LogLevel::ERROR, "ERROR: Invalid host \"{}\"!", host);
+      conn_state = CS_FAILED;
     } else {
-      flags.set(1);
-      flags.set(8);
+      album_art_needed = true;
     }
   }
 }
@@ -77,11 +237,41 @@ MPDClient::MPDClient(std::string host, uint16_t host_port, LogLevel level,
 MPDClient::~MPDClient() { cleanup_close_conn(); }
 
 MPDClient::MPDClient(MPDClient &&other)
-    : flags(std::move(other.flags)),
+    : ping_ok(other.ping_ok),
+      status_ok(other.status_ok),
+      current_song_ok(other.current_song_ok),
+      binary_limit_set(other.binary_limit_set),
+      auth_required(other.auth_required),
+      auth_pending(other.auth_pending),
+      auth_rejected(other.auth_rejected),
+      is_unix_socket(other.is_unix_socket),
+      is_art_client(other.is_art_client),
+      conn_state(other.conn_state),
+      idle_state(other.idle_state),
+      awaiting_response(other.awaiting_response),
+      pending_response(other.pending_response),
+      album_art_needed(other.album_art_needed),
+      no_readpicture(other.no_readpicture),
+      no_albumart(other.no_albumart),
+      album_art_failed(other.album_art_failed),
+      album_art_for_next_song(other.album_art_for_next_song),
+      next_song_fetched(other.next_song_fetched),
+      next_album_art_fetched(other.next_album_art_fetched),
+      album_art_on_main(other.album_art_on_main),
+      album_art_refetch(other.album_art_refetch),
       level(std::move(other.level)),
-      host_ip_value(std::move(other.host_ip_value)),
+      host_name(std::move(other.host_name)),
       host_port(std::move(other.host_port)),
       conn_socket(std::move(other.conn_socket)),
+      uring(std::move(other.uring)),
+      use_io_uring(other.use_io_uring),
+      uring_sending_noidle(other.uring_sending_noidle),
+      resolver(std::move(other.resolver)),
+      connect_addrs(std::move(other.connect_addrs)),
+      connect_addrs_idx(other.connect_addrs_idx),
+      connect_sockets(std::move(other.connect_sockets)),
+      connect_attempt_time(other.connect_attempt_time),
+      connect_errno(other.connect_errno),
       socket_path(std::move(other.socket_path)),
       song_title(std::move(other.song_title)),
       song_artist(std::move(other.song_artist)),
@@ -91,21 +281,97 @@ MPDClient::MPDClient(MPDClient &&other)
       elapsed_time_point(std::move(other.elapsed_time_point)),
       elapsed_time(other.elapsed_time),
       song_duration(other.song_duration),
+      fetched_album_art(std::move(other.fetched_album_art)),
+      fetched_album_art_mime_type(std::move(other.fetched_album_art_mime_type)),
+      song_id(std::move(other.song_id)),
+      status_song_id(std::move(other.status_song_id)),
+      playlist_version(std::move(other.playlist_version)),
+      status_playlist_version(std::move(other.status_playlist_version)),
+      next_song_id(std::move(other.next_song_id)),
+      status_next_song_id(std::move(other.status_next_song_id)),
+      next_song_title(std::move(other.next_song_title)),
+      next_song_artist(std::move(other.next_song_artist)),
+      next_song_album(std::move(other.next_song_album)),
+      next_song_filename(std::move(other.next_song_filename)),
+      next_album_art(std::move(other.next_album_art)),
+      next_album_art_mime_type(std::move(other.next_album_art_mime_type)),
       album_art(std::move(other.album_art)),
-      dummy_album_art_ref(),
       album_art_mime_type(std::move(other.album_art_mime_type)),
       album_art_offset(std::move(other.album_art_offset)),
-      album_art_expected_size(other.album_art_expected_size) {
+      album_art_expected_size(other.album_art_expected_size),
+      album_art_chunk_size(other.album_art_chunk_size),
+      album_art_request_offset(other.album_art_request_offset),
+      write_buf(std::move(other.write_buf)),
+      recv_buf(std::move(other.recv_buf)),
+      response_size(other.response_size),
+      parser(other.parser),
+      io_deadline(other.io_deadline),
+      last_heard_time(other.last_heard_time),
+      connect_timeout(other.connect_timeout),
+      heartbeat_interval(other.heartbeat_interval),
+      current_command(other.current_command),
+      song_info_request(other.song_info_request),
+      status_time(other.status_time),
+      binary_limit(other.binary_limit),
+      round_trip_time(other.round_trip_time),
+      bytes_per_second(other.bytes_per_second),
+      request_time(other.request_time),
+      request_latency(other.request_latency),
+      request_bytes(other.request_bytes),
+      request_chunks(other.request_chunks),
+      art_client(std::move(other.art_client)),
+      art_client_retry_time(other.art_client_retry_time),
+      password(std::move(other.password)),
+      auth_password(std::move(other.auth_password)),
+      album_art_filename(std::move(other.album_art_filename)),
+      partial_album_art(std::move(other.partial_album_art)),
+      art_cache(std::move(other.art_cache)),
+      trace(std::move(other.trace)),
+      trace_connection(other.trace_connection) {
   other.conn_socket = -1;
+  other.connect_sockets.clear();
 }
 
 MPDClient &MPDClient::operator=(MPDClient &&other) {
-  this->flags = std::move(other.flags);
+  cleanup_close_conn();
+
+  this->ping_ok = other.ping_ok;
+  this->status_ok = other.status_ok;
+  this->current_song_ok = other.current_song_ok;
+  this->binary_limit_set = other.binary_limit_set;
+  this->auth_required = other.auth_required;
+  this->auth_pending = other.auth_pending;
+  this->auth_rejected = other.auth_rejected;
+  this->is_unix_socket = other.is_unix_socket;
+  this->is_art_client = other.is_art_client;
+  this->conn_state = other.conn_state;
+  this->idle_state = other.idle_state;
+  this->awaiting_response = other.awaiting_response;
+  this->pending_response = other.pending_response;
+  this->album_art_needed = other.album_art_needed;
+  this->no_readpicture = other.no_readpicture;
+  this->no_albumart = other.no_albumart;
+  this->album_art_failed = other.album_art_failed;
+  this->album_art_for_next_song = other.album_art_for_next_song;
+  this->next_song_fetched = other.next_song_fetched;
+  this->next_album_art_fetched = other.next_album_art_fetched;
+  this->album_art_on_main = other.album_art_on_main;
+  this->album_art_refetch = other.album_art_refetch;
   this->level = std::move(other.level);
-  this->host_ip_value = std::move(other.host_ip_value);
+  this->host_name = std::move(other.host_name);
   this->host_port = other.host_port;
   this->conn_socket = other.conn_socket;
   other.conn_socket = -1;
+  this->uring = std::move(other.uring);
+  this->use_io_uring = other.use_io_uring;
+  this->uring_sending_noidle = other.uring_sending_noidle;
+  this->resolver = std::move(other.resolver);
+  this->connect_addrs = std::move(other.connect_addrs);
+  this->connect_addrs_idx = other.connect_addrs_idx;
+  this->connect_sockets = std::move(other.connect_sockets);
+  other.connect_sockets.clear();
+  this->connect_attempt_time = other.connect_attempt_time;
+  this->connect_errno = other.connect_errno;
   this->socket_path = std::move(other.socket_path);
   this->song_title = std::move(other.song_title);
   this->song_artist = std::move(other.song_artist);
@@ -115,890 +381,1907 @@ MPDClient &MPDClient::operator=(MPDClient &&other) {
   this->elapsed_time_point = std::move(other.elapsed_time_point);
   this->elapsed_time = other.elapsed_time;
   this->song_duration = other.song_duration;
+  this->fetched_album_art = std::move(other.fetched_album_art);
+  this->fetched_album_art_mime_type =
+      std::move(other.fetched_album_art_mime_type);
+  this->song_id = std::move(other.song_id);
+  this->status_song_id = std::move(other.status_song_id);
+  this->playlist_version = std::move(other.playlist_version);
+  this->status_playlist_version = std::move(other.status_playlist_version);
+  this->next_song_id = std::move(other.next_song_id);
+  this->status_next_song_id = std::move(other.status_next_song_id);
+  this->next_song_title = std::move(other.next_song_title);
+  this->next_song_artist = std::move(other.next_song_artist);
+  this->next_song_album = std::move(other.next_song_album);
+  this->next_song_filename = std::move(other.next_song_filename);
+  this->next_album_art = std::move(other.next_album_art);
+  this->next_album_art_mime_type = std::move(other.next_album_art_mime_type);
   this->album_art = std::move(other.album_art);
   this->album_art_mime_type = std::move(other.album_art_mime_type);
   this->album_art_offset = std::move(other.album_art_offset);
   this->album_art_expected_size = other.album_art_expected_size;
+  this->album_art_chunk_size = other.album_art_chunk_size;
+  this->album_art_request_offset = other.album_art_request_offset;
+  this->write_buf = std::move(other.write_buf);
+  this->recv_buf = std::move(other.recv_buf);
+  this->response_size = other.response_size;
+  this->parser = other.parser;
+  this->io_deadline = other.io_deadline;
+  this->last_heard_time = other.last_heard_time;
+  this->connect_timeout = other.connect_timeout;
+  this->heartbeat_interval = other.heartbeat_interval;
+  this->current_command = other.current_command;
+  this->song_info_request = other.song_info_request;
+  this->status_time = other.status_time;
+  this->binary_limit = other.binary_limit;
+  this->round_trip_time = other.round_trip_time;
+  this->bytes_per_second = other.bytes_per_second;
+  this->request_time = other.request_time;
+  this->request_latency = other.request_latency;
+  this->request_bytes = other.request_bytes;
+  this->request_chunks = other.request_chunks;
+  this->art_client = std::move(other.art_client);
+  this->art_client_retry_time = other.art_client_retry_time;
+  this->password = std::move(other.password);
+  this->auth_password = std::move(other.auth_password);
+  this->album_art_filename = std::move(other.album_art_filename);
+  this->partial_album_art = std::move(other.partial_album_art);
+  this->art_cache = std::move(other.art_cache);
+  this->trace = std::move(other.trace);
+  this->trace_connection = other.trace_connection;
 
   return *this;
 }
 
 void MPDClient::reset_connection() {
-  flags.reset(0);
-  flags.set(1);
-  flags.reset(2);
-  flags.reset(3);
-  flags.reset(4);
-  flags.reset(5);
-  flags.reset(6);
-  flags.reset(7);
-  flags.set(8);
-  album_art = std::nullopt;
+  // What was fetched of the album art survives the reconnect.
+  PartialAlbumArt partial = take_partial_album_art();
+  if (partial.data) {
+    partial_album_art = std::move(partial);
+  }
+
+  set_conn_state(CS_INIT);
+  ping_ok = false;
+  status_ok = false;
+  current_song_ok = false;
+  binary_limit_set = false;
+  auth_required = false;
+  idle_state = IS_NONE;
+  awaiting_response = false;
+  album_art_needed = true;
+  pending_response = PR_NONE;
+  album_art_for_next_song = false;
+  next_song_fetched = false;
+  next_album_art_fetched = false;
+  album_art_on_main = false;
+  album_art_refetch = false;
+  auth_pending = false;
+  auth_rejected = false;
+  auth_password.clear();
+  current_command = CMD_NONE;
+  art_client.reset();
+  album_art_filename.clear();
+  write_buf.clear();
+  recv_buf.clear();
+  response_size = 0;
+  parser.reset();
+  album_art.reset();
+  fetched_album_art.reset();
+  fetched_album_art_mime_type.clear();
   song_title.clear();
   song_artist.clear();
   song_album.clear();
   song_filename.clear();
+  song_id.clear();
+  status_song_id.clear();
+  playlist_version.clear();
+  status_playlist_version.clear();
+  next_song_id.clear();
+  status_next_song_id.clear();
+  next_song_title.clear();
+  next_song_artist.clear();
+  next_song_album.clear();
+  next_song_filename.clear();
+  next_album_art.reset();
+  next_album_art_mime_type.clear();
   album_art_offset = std::nullopt;
   album_art_expected_size = 0;
+  album_art_chunk_size = 0;
   album_art_mime_type.clear();
   cleanup_close_conn();
 }
 
-bool MPDClient::is_ok() const { return !flags.test(0); }
+PartialAlbumArt MPDClient::take_partial_album_art() {
+  if (art_client) {
+    PartialAlbumArt partial = art_client->take_partial_album_art();
+    if (partial.data) {
+      partial_album_art = std::move(partial);
+    }
+  }
+  save_partial_album_art();
+  return std::exchange(partial_album_art, PartialAlbumArt());
+}
 
-bool MPDClient::needs_auth() const { return flags.test(5); }
+void MPDClient::set_partial_album_art(PartialAlbumArt partial) {
+  partial_album_art = std::move(partial);
+}
 
-bool MPDClient::attempt_auth(std::string passwd) {
-  if (!is_ok() || conn_socket < 0) {
-    return false;
+void MPDClient::set_trace(std::shared_ptr<ProtocolTrace> trace) {
+  this->trace = std::move(trace);
+  if (art_client) {
+    art_client->trace = this->trace;
   }
+}
 
-  std::vector<char> vec;
-  vec.push_back('p');
-  vec.push_back('a');
-  vec.push_back('s');
-  vec.push_back('s');
-  vec.push_back('w');
-  vec.push_back('o');
-  vec.push_back('r');
-  vec.push_back('d');
-  vec.push_back(' ');
-
-  for (char c : passwd) {
-    vec.push_back(c);
-  }
-  vec.push_back('\n');
-
-  ssize_t write_ret = write(conn_socket, vec.data(), vec.size());
-  if (write_ret == static_cast<ssize_t>(vec.size())) {
-    // Successful write, do nothing here.
-  } else if (errno == EAGAIN) {
-    // Re-attempt auth later.
-    LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Re-attempt auth later.");
-    return false;
-  } else {
-    flags.set(0);
-    LOG_PRINT(level, LogLevel::ERROR,
-              "ERROR: Failed to auth with MPD! errno {}", errno);
-    return false;
-  }
+const std::shared_ptr<ProtocolTrace> &MPDClient::get_trace() const {
+  return trace;
+}
 
-  uint8_t buf[READ_BUF_SIZE_SMALL];
-  std::memset(buf, 0, READ_BUF_SIZE_SMALL);
-  bool read_success = false;
-  do {
-    ssize_t read_ret = read(conn_socket, buf, READ_BUF_SIZE_SMALL);
-    if (read_ret > 1) {
-      LOG_PRINT(level, LogLevel::VERBOSE, "{:.{}s}",
-                reinterpret_cast<const char *>(buf), read_ret);
-      if (buf[0] == 'O' && buf[1] == 'K') {
-        // Success, clear "need auth" flag.
-        flags.reset(5);
-        read_success = true;
-        LOG_PRINT(level, LogLevel::WARNING,
-                  "Successfully authenticated with MPD.");
-        return true;
-      } else {
-        // Failed to auth, don't change any flags.
-        LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to auth with MPD!");
-        return false;
-      }
-    } else {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        // Non-blocking IO indicating not ready yet.
-        std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-        continue;
-      }
-      flags.set(0);
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to auth with MPD (check OK)!");
-      return false;
-    }
-  } while (!read_success);
-  return false;
+void MPDClient::set_io_uring(bool enabled) {
+  use_io_uring = enabled;
+  if (art_client) {
+    art_client->use_io_uring = enabled;
+  }
 }
 
-void MPDClient::update() {
-  if (flags.test(0)) {
-    return;
-  } else if (flags.test(1)) {
-    flags.reset(1);
+bool MPDClient::is_using_io_uring() const { return uring.is_open(); }
 
-    // Initialize connection.
-    cleanup_close_conn();
+void MPDClient::save_partial_album_art() {
+  if (!album_art || !album_art_offset.has_value() ||
+      album_art_offset.value() == 0 ||
+      album_art_offset.value() >= album_art_expected_size) {
+    return;
+  }
 
-    if (flags.test(12)) {
-      conn_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-      if (conn_socket < 0) {
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "Failed to create unix socket: errno {}", errno);
-        return;
-      }
+  partial_album_art.filename =
+      is_art_client
+          ? album_art_filename
+          : (album_art_for_next_song ? next_song_filename : song_filename);
+  partial_album_art.data = album_art;
+  partial_album_art.offset = album_art_offset.value();
+  partial_album_art.expected_size = album_art_expected_size;
+  partial_album_art.mime_type = album_art_mime_type;
+  partial_album_art.from_albumart = no_readpicture;
+}
 
-      struct sockaddr_un unix_sockaddr;
-      unix_sockaddr.sun_family = AF_UNIX;
+bool MPDClient::is_ok() const { return conn_state != CS_FAILED; }
 
-      if (this->socket_path.size() + 1 >= sizeof(unix_sockaddr.sun_path)) {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "Failed to create unix socket, path too long");
-        return;
-      }
+bool MPDClient::is_connecting() const {
+  return conn_state == CS_RESOLVING || conn_state == CS_CONNECTING;
+}
 
-      std::memcpy(unix_sockaddr.sun_path, this->socket_path.c_str(),
-                  this->socket_path.size() + 1);
+bool MPDClient::needs_auth() const { return auth_required; }
 
-      int ret =
-          connect(conn_socket,
-                  reinterpret_cast<const struct sockaddr *>(&unix_sockaddr),
-                  sizeof(unix_sockaddr));
+void MPDClient::attempt_auth(std::string passwd) {
+  if (!is_ok()) {
+    auth_rejected = true;
+    return;
+  }
 
-      if (ret < 0) {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "Failed to connect unix socket, errno {}:", errno);
-        return;
-      }
-    } else {
-      conn_socket = socket(AF_INET, SOCK_STREAM, 0);
-      if (conn_socket < 0) {
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "Failed to create tcp socket: errno {}", errno);
-        return;
-      }
+  // Sent by "run_next_command()", the result is known once
+  // "is_authenticating()" is false.
+  auth_password = std::move(passwd);
+  auth_pending = true;
+  auth_rejected = false;
+}
 
-      struct sockaddr_in ipv4_sockaddr;
-      std::memset(&ipv4_sockaddr, 0, sizeof(struct sockaddr_in));
-      ipv4_sockaddr.sin_family = AF_INET;
-      if (helper_is_big_endian()) {
-        ipv4_sockaddr.sin_port = host_port;
-      } else {
-        ipv4_sockaddr.sin_port = htons(host_port);
-      }
-      ipv4_sockaddr.sin_addr.s_addr = host_ip_value.value();
+bool MPDClient::is_authenticating() const {
+  return is_ok() && auth_pending;
+}
 
-      LOG_PRINT(level, LogLevel::VERBOSE,
-                "VERBOSE: host_ip: {:x}, host port: {:x}",
-                ipv4_sockaddr.sin_addr.s_addr, ipv4_sockaddr.sin_port);
+bool MPDClient::auth_failed() const { return auth_rejected; }
 
-      int connect_ret =
-          connect(conn_socket,
-                  reinterpret_cast<const struct sockaddr *>(&ipv4_sockaddr),
-                  sizeof(struct sockaddr_in));
-      if (connect_ret != 0) {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to connect to host! errno {}", errno);
-        return;
-      }
-    }
+void MPDClient::update() {
+  // Keep going while requests complete without waiting on the socket.
+  for (int step = 0; step < MPD_CLI_MAX_UPDATE_STEPS && update_step(); ++step) {
+  }
+  update_art_client();
+}
 
-    int fcntl_ret = fcntl(conn_socket, F_SETFL, O_NONBLOCK);
-    if (fcntl_ret == -1) {
-      cleanup_close_conn();
-      flags.set(0);
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to set non-blocking on conn_socket! errno {}",
-                errno);
-      return;
+bool MPDClient::update_step() {
+  if (idle_state != IS_NONE && is_ok()) {
+    if (!update_idle()) {
+      return false;
     }
+  }
 
-    flags.set(4);
-    auto [status, str] = write_read("");
-    LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Init write_read: {}",
-              status_to_str(status));
-    if (flags.test(0)) {
-      return;
-    } else if (!str.empty()) {
-      if (str.at(0) == 'O' && str.at(1) == 'K') {
-        // Successful, do nothing here.
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to get initial OK from MPD!");
-        return;
+  switch (conn_state) {
+    case CS_INIT:
+      return start_connection();
+    case CS_RESOLVING:
+      return update_resolving();
+    case CS_CONNECTING:
+      if (!check_connect()) {
+        return false;
       }
-    } else {
-      cleanup_close_conn();
-      flags.set(0);
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to read initial OK from MPD!");
-      return;
-    }
-
-    // Set the max binary size:
-    bool binary_size_set = false;
-    do {
-      std::tie(status, str) =
-          write_read(std::format("binarylimit {}\n", MPD_BINARY_LIMIT));
-      if (flags.test(0) || (status != StatusEnum::SE_SUCCESS &&
-                            status != StatusEnum::SE_EAGAIN_ON_READ)) {
-        cleanup_close_conn();
-        flags.set(0);
-        return;
-      } else if (status == StatusEnum::SE_EAGAIN_ON_READ) {
-        flags.set(4);
-      } else if (status == StatusEnum::SE_SUCCESS) {
-        if (str.at(0) == 'O' && str.at(1) == 'K') {
-          // Success.
-          binary_size_set = true;
-          continue;
-        } else {
-          cleanup_close_conn();
-          flags.set(0);
-          LOG_PRINT(level, LogLevel::ERROR,
-                    "ERROR: Failed to set \"binarylimit\", no OK!");
-          return;
-        }
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to set \"binarylimit\"!");
-        return;
+      if (use_io_uring && uring.open(conn_socket)) {
+        LOG_PRINT(level, LogLevel::VERBOSE,
+                  "VERBOSE: Using io_uring on the connection.");
       }
-
-      std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-    } while (!binary_size_set);
-  } else if (flags.test(5)) {
-    // Do nothing, wait for authentication.
-  } else if (!flags.test(2)) {
-    // Do ping.
-    bool successful_write_read = false;
-    do {
-      auto [status, str] = write_read("ping\n");
-
-      if (flags.test(0) || (status != StatusEnum::SE_SUCCESS &&
-                            status != StatusEnum::SE_EAGAIN_ON_READ)) {
-        cleanup_close_conn();
-        flags.set(0);
-        return;
-      } else if (status == StatusEnum::SE_EAGAIN_ON_READ) {
-        flags.set(4);
-      } else if (status == StatusEnum::SE_SUCCESS) {
-        if (str.at(0) == 'O' && str.at(1) == 'K') {
-          // Success
-          successful_write_read = true;
-          flags.set(2);
-          continue;
-        } else {
-          cleanup_close_conn();
-          flags.set(0);
-          LOG_PRINT(level, LogLevel::ERROR,
-                    "ERROR: Failed to ping MPD (no OK)!");
-          return;
-        }
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to ping MPD!");
-        return;
+      // MPD greets with "OK MPD <version>", read it without writing anything.
+      awaiting_response = true;
+      parser.reset();
+      io_deadline = std::chrono::steady_clock::now() + MPD_CLI_READ_TIMEOUT;
+      set_conn_state(CS_GREETING);
+      return true;
+    case CS_GREETING:
+      return read_greeting();
+    case CS_READY:
+      if (auth_required && !auth_pending) {
+        // Do nothing, wait for a password.
+        return false;
       }
+      return run_next_command();
+    case CS_FAILED:
+    default:
+      return false;
+  }
+}
 
-      std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-    } while (!successful_write_read);
-  } else if (!flags.test(3)) {
-    // Do "status".
-    bool successful_write_read = false;
-    do {
-      auto [status, str] = write_read("status\n");
-
-      if (flags.test(0) || (status != StatusEnum::SE_SUCCESS &&
-                            status != StatusEnum::SE_EAGAIN_ON_READ)) {
-        cleanup_close_conn();
-        flags.set(0);
-        return;
-      } else if (status == StatusEnum::SE_EAGAIN_ON_READ) {
-        flags.set(4);
-      } else if (status == StatusEnum::SE_SUCCESS) {
-        if (str.at(str.size() - 3) == 'O' && str.at(str.size() - 2) == 'K' &&
-            str.at(str.size() - 1) == '\n') {
-          // Success
-          flags.set(3);
-          successful_write_read = true;
-          parse_for_song_info(str);
-          continue;
-        } else if (str.at(0) == 'A' && str.at(1) == 'C' && str.at(2) == 'K') {
-          if (str.at(5) == '4' && str.at(6) == '@') {
-            // Permission/Auth required
-            flags.set(5);
-            LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
-            return;
-          } else {
-            cleanup_close_conn();
-            flags.set(0);
-            LOG_PRINT(level, LogLevel::ERROR,
-                      "ERROR: Failed to \"status\" MPD (ACK)!");
-            return;
-          }
-        } else {
-          cleanup_close_conn();
-          flags.set(0);
-          LOG_PRINT(level, LogLevel::ERROR,
-                    "ERROR: Failed to \"status\" MPD (no OK)!");
-          return;
-        }
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to \"status\" MPD!");
-        return;
-      }
+void MPDClient::set_conn_state(ConnState state) {
+  LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Connection state {} -> {}",
+            conn_state_to_str(conn_state), conn_state_to_str(state));
+  conn_state = state;
+}
 
-      std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-    } while (!successful_write_read);
-  } else if (!flags.test(6)) {
-    // Do "currentsong".
-    bool successful_write_read = false;
-    do {
-      auto [status, str] = write_read("currentsong\n");
+bool MPDClient::start_connection() {
+  cleanup_close_conn();
 
-      if (flags.test(0) || (status != StatusEnum::SE_SUCCESS &&
-                            status != StatusEnum::SE_EAGAIN_ON_READ)) {
-        cleanup_close_conn();
-        flags.set(0);
-        return;
-      } else if (status == StatusEnum::SE_EAGAIN_ON_READ) {
-        flags.set(4);
-      } else if (status == StatusEnum::SE_SUCCESS) {
-        if (str.at(str.size() - 3) == 'O' && str.at(str.size() - 2) == 'K' &&
-            str.at(str.size() - 1) == '\n') {
-          // Success
-          flags.set(6);
-          successful_write_read = true;
-          parse_for_song_info(str);
-          continue;
-        } else if (str.at(0) == 'A' && str.at(1) == 'C' && str.at(2) == 'K') {
-          if (str.at(5) == '4' && str.at(6) == '@') {
-            // Permission/Auth required
-            flags.set(5);
-            LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
-            return;
-          } else {
-            cleanup_close_conn();
-            flags.set(0);
-            LOG_PRINT(level, LogLevel::ERROR,
-                      "ERROR: Failed to \"currentsong\" MPD (ACK)!");
-            return;
-          }
-        } else {
-          cleanup_close_conn();
-          flags.set(0);
-          LOG_PRINT(level, LogLevel::ERROR,
-                    "ERROR: Failed to \"currentsong\" MPD (no OK)!");
-          return;
-        }
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to \"currentsong\" MPD!");
-        return;
-      }
+  // The receive buffer is allocated once and reused across reconnects.
+  if (recv_buf.capacity() == 0) {
+    recv_buf = RingBuffer(READ_BUF_SIZE);
+  }
 
-      std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-    } while (!successful_write_read);
-  } else if (flags.test(8) && !song_filename.empty() &&
-             (!flags.test(9) || !flags.test(10))) {
-    // Fetch album art
-    std::string song_filename_escaped =
-        helper_replace_in_string(song_filename, "\\", "\\\\");
-    song_filename_escaped =
-        helper_replace_in_string(song_filename_escaped, "\"", "\\\"");
-    std::string cmd;
-    if (!flags.test(9)) {
-      cmd = std::format(
-          "readpicture \"{}\" {}\n", song_filename_escaped,
-          album_art_offset.has_value() ? album_art_offset.value() : 0);
-    } else if (!flags.test(10)) {
-      cmd = std::format(
-          "albumart \"{}\" {}\n", song_filename_escaped,
-          album_art_offset.has_value() ? album_art_offset.value() : 0);
-    } else {
-      flags.reset(8);
-      flags.set(11);
-      album_art = std::nullopt;
-      album_art_offset = std::nullopt;
-      album_art_expected_size = 0;
-      album_art_mime_type.clear();
-      return;
-    }
-    auto [status, buf] = write_read(cmd);
-    if (flags.test(0) ||
-        (status != SE_SUCCESS && status != SE_EAGAIN_ON_READ)) {
-      cleanup_close_conn();
-      flags.set(0);
+  // Measurements don't carry over to a new connection.
+  binary_limit = MPD_BINARY_LIMIT;
+  round_trip_time = std::chrono::microseconds(0);
+  bytes_per_second = 0.0;
+
+  io_deadline = std::chrono::steady_clock::now() + connect_timeout;
+  if (is_unix_socket) {
+    SockAddr unix_addr;
+    std::memset(&unix_addr, 0, sizeof(SockAddr));
+    struct sockaddr_un *unix_sockaddr =
+        reinterpret_cast<struct sockaddr_un *>(&unix_addr.addr);
+    unix_sockaddr->sun_family = AF_UNIX;
+
+    if (this->socket_path.size() + 1 >= sizeof(unix_sockaddr->sun_path)) {
+      set_conn_state(CS_FAILED);
       LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Internal error while fetching album art from MPD!");
-      flags.reset(8);
-      flags.set(11);
-      album_art = std::nullopt;
-      album_art_offset = std::nullopt;
-      album_art_expected_size = 0;
-      album_art_mime_type.clear();
-      return;
-    } else if (buf.at(0) == 'A' && buf.at(1) == 'C' && buf.at(2) == 'K') {
-      if (buf.at(5) == '4' && buf.at(6) == '@') {
-        // Permission/Auth required
-        flags.set(5);
-        LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
-        return;
-      } else if (!flags.test(9)) {
-        flags.set(9);
-        LOG_PRINT(level, LogLevel::WARNING,
-                  "WARNING: song has no embedded album art!");
-      } else if (!flags.test(10)) {
-        flags.set(10);
-        LOG_PRINT(level, LogLevel::WARNING,
-                  "WARNING: song has no cover image!");
-        if (flags.test(9) && flags.test(10)) {
-          flags.reset(8);
-          flags.set(11);
-          album_art = std::nullopt;
-          album_art_offset = std::nullopt;
-          album_art_expected_size = 0;
-          album_art_mime_type.clear();
-          return;
-        }
-      } else {
-        flags.reset(8);
-        flags.set(11);
-        album_art = std::nullopt;
-        album_art_offset = std::nullopt;
-        album_art_expected_size = 0;
-        album_art_mime_type.clear();
-        return;
-      }
-    } else if (album_art.has_value() &&
-               album_art.value().size() == album_art_expected_size) {
-      flags.reset(8);
-      LOG_PRINT(level, LogLevel::DEBUG,
-                "DEBUG: Fetched \"readpicture/albumart\" data. (size {})",
-                album_art->size());
-    } else if (album_art.has_value() &&
-               album_art.value().size() > album_art_expected_size) {
-      LOG_PRINT(level, LogLevel::ERROR, "ERROR: Invalid album_art size!");
-      album_art = std::nullopt;
-      album_art_offset = std::nullopt;
-      album_art_expected_size = 0;
-      album_art_mime_type.clear();
+                "Failed to create unix socket, path too long");
+      return false;
     }
+
+    std::memcpy(unix_sockaddr->sun_path, this->socket_path.c_str(),
+                this->socket_path.size() + 1);
+    unix_addr.len = sizeof(struct sockaddr_un);
+
+    connect_addrs.assign(1, unix_addr);
+    connect_addrs_idx = 0;
+    set_conn_state(CS_CONNECTING);
   } else {
+    resolver.start(host_name, host_port);
+    set_conn_state(CS_RESOLVING);
   }
+  return true;
 }
 
-const std::string &MPDClient::get_song_title() const { return song_title; }
-const std::string &MPDClient::get_song_artist() const { return song_artist; }
-const std::string &MPDClient::get_song_album() const { return song_album; }
-const std::string &MPDClient::get_song_filename() const {
-  return song_filename;
-}
-double MPDClient::get_song_duration() const { return song_duration; }
-std::tuple<double, std::chrono::steady_clock::time_point>
-MPDClient::get_elapsed_time() const {
-  return {elapsed_time, elapsed_time_point};
-}
-const std::optional<std::vector<char> > &MPDClient::get_album_art() const {
-  if (album_art.has_value()) {
-    if (album_art.value().size() == album_art_expected_size) {
-      return album_art;
+bool MPDClient::update_resolving() {
+  if (!resolver.is_done()) {
+    if (std::chrono::steady_clock::now() > io_deadline) {
+      set_conn_state(CS_FAILED);
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Timed out resolving host \"{}\"!", host_name);
     }
+    return false;
   }
-  return dummy_album_art_ref;
-}
-const std::string &MPDClient::get_album_art_mime_type() const {
-  return album_art_mime_type;
-}
 
-const std::string &MPDClient::get_play_state() const { return mpd_play_state; }
-
-bool MPDClient::song_has_album_art() const { return !flags.test(11); }
-
-void MPDClient::request_data_update() {
-  flags.reset(3);
-  flags.reset(6);
+  connect_addrs = resolver.take_results();
+  connect_addrs_idx = 0;
+  if (connect_addrs.empty()) {
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to resolve host \"{}\": {}", host_name,
+              gai_strerror(resolver.get_error()));
+    return false;
+  }
+  LOG_PRINT(level, LogLevel::VERBOSE,
+            "VERBOSE: Resolved host \"{}\" to {} address(es)", host_name,
+            connect_addrs.size());
+  set_conn_state(CS_CONNECTING);
+  return true;
 }
 
-void MPDClient::request_refetch_album_art() {
-  flags.set(8);
-  album_art = std::nullopt;
-  album_art_expected_size = 0;
-  album_art_mime_type.clear();
-  album_art_offset = 0;
-  flags.reset(9);
-  flags.reset(10);
-  flags.reset(11);
-}
+bool MPDClient::read_greeting() {
+  auto [status, str] = write_read("");
+  LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Init write_read: {}",
+            status_to_str(status));
+  if (!is_ok()) {
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  } else if (status == StatusEnum::SE_SUCCESS && str.starts_with("OK")) {
+    // Successful.
+    set_conn_state(CS_READY);
+    return true;
+  }
 
-bool MPDClient::ping_success() const { return flags.test(2); }
+  cleanup_close_conn();
+  set_conn_state(CS_FAILED);
+  LOG_PRINT(level, LogLevel::ERROR,
+            "ERROR: Failed to read initial OK from MPD!");
+  return false;
+}
 
-std::tuple<MPDClient::StatusEnum, std::string> MPDClient::write_read(
-    std::string to_send) {
-  if (!is_ok() || conn_socket < 0) {
-    return {StatusEnum::SE_GENERIC_ERROR, {}};
+bool MPDClient::run_next_command() {
+  if (write_buf.empty() && !awaiting_response) {
+    // Nothing in flight, pick the next request.
+    if (is_art_client && song_filename != album_art_filename) {
+      // Album art connection, a different file was asked for.
+      album_art_filename = song_filename;
+      album_art_needed = true;
+      no_readpicture = false;
+      no_albumart = false;
+      album_art_failed = false;
+      fetched_album_art.reset();
+      fetched_album_art_mime_type.clear();
+      discard_album_art();
+      album_art_chunk_size = 0;
+    }
+    current_command = next_command();
   }
 
-  LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: sending: {:.{}}",
-            to_send.empty() ? "Nothing" : to_send,
-            to_send.empty() ? 7 : to_send.size() - 1);
-
-  const auto write_timestamp = std::chrono::steady_clock::now();
-  bool did_write_this_iteration = false;
-  if (!flags.test(4)) {
-    bool successful_write = false;
-    do {
-      ssize_t write_ret = write(conn_socket, to_send.data(), to_send.size());
-      if (write_ret == static_cast<ssize_t>(to_send.size())) {
-        // Success.
-        flags.set(4);
-        did_write_this_iteration = true;
-        successful_write = true;
-        continue;
-      } else if (write_ret < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-          // Non-blocking IO, try again soon.
-          const auto current_timestamp = std::chrono::steady_clock::now();
-          if (current_timestamp - write_timestamp > MPD_CLI_WRITE_TIMEOUT) {
-            LOG_PRINT(level, LogLevel::WARNING,
-                      "WARNING: MPDCli write timed out!");
-            return {StatusEnum::SE_WRITE_TIMED_OUT, {}};
-          }
-          std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-          continue;
-        }
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to write \"{}\"! (errno {})", to_send, errno);
-        return {};
-      } else {
-        cleanup_close_conn();
-        flags.set(0);
-        LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to write \"{}\"!",
-                  to_send);
-        return {StatusEnum::SE_GENERIC_ERROR, {}};
+  switch (current_command) {
+    case CMD_PASSWORD:
+      return send_password();
+    case CMD_BINARYLIMIT:
+      return send_binarylimit();
+    case CMD_PING:
+      return send_ping();
+    case CMD_STATUS:
+      return send_status();
+    case CMD_ALBUM_ART:
+      return update_album_art(is_art_client ? album_art_filename
+                                             : song_filename);
+    case CMD_NEXT_SONG:
+      return send_next_song();
+    case CMD_NEXT_ALBUM_ART:
+      if (!album_art_for_next_song) {
+        album_art_for_next_song = true;
+        no_readpicture = false;
+        no_albumart = false;
+        discard_album_art();
       }
-    } while (!successful_write);
+      return update_album_art(next_song_filename);
+    case CMD_NONE:
+    default:
+      // Nothing left to fetch, wait for MPD to report changes.
+      enter_idle();
+      return false;
   }
+}
 
-  LOG_PRINT(level, LogLevel::VERBOSE,
-            "VERBOSE: write_read: read after write...");
-
-  std::string str;
-  std::vector<char> buf;
-  buf.resize(READ_BUF_SIZE);
-  std::optional<unsigned long> binary_size{};
-  std::optional<std::chrono::time_point<std::chrono::steady_clock> >
-      binary_size_read_start{};
+MPDClient::Command MPDClient::next_command() const {
+  if (auth_pending) {
+    return CMD_PASSWORD;
+  } else if (!binary_limit_set) {
+    return CMD_BINARYLIMIT;
+  } else if (!ping_ok) {
+    return CMD_PING;
+  } else if (is_art_client) {
+    // The album art connection only fetches album art.
+    return album_art_needed && !album_art_filename.empty() ? CMD_ALBUM_ART
+                                                        : CMD_NONE;
+  } else if (!status_ok || !current_song_ok) {
+    return CMD_STATUS;
+  }
 
-  const auto read_timestamp = std::chrono::steady_clock::now();
-  bool successful_read = false;
-  do {
-    ssize_t read_ret = read(conn_socket, buf.data(), buf.size());
-    if (read_ret > 0) {
-      str.append(buf.data(), static_cast<size_t>(read_ret));
-      // Read to full until EAGAIN/EWOULDBLOCK.
-      LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Read {} bytes...",
-                read_ret);
-      continue;
-    } else if (read_ret < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        if (str.empty()) {
-          // Non-blocking IO, try again soon.
-          const auto current_timestamp = std::chrono::steady_clock::now();
-          if (current_timestamp - read_timestamp > MPD_CLI_READ_TIMEOUT) {
-            LOG_PRINT(level, LogLevel::WARNING,
-                      "WARNING: MPDCli read timed out!");
-            return {StatusEnum::SE_READ_TIMED_OUT, {}};
-          }
-          std::this_thread::sleep_for(LOOP_SLEEP_TIME);
-          continue;
-        } else {
-          flags.reset(4);
-          if (size_t idx = str.find("\nbinary: "); idx != std::string::npos) {
-            ++idx;
-            size_t end_idx = str.find('\n', idx);
-            if (end_idx != std::string::npos) {
-              // check if binary size amount was read
-              if (!binary_size.has_value()) {
-                try {
-                  binary_size =
-                      std::stoul(str.substr(idx + 8, end_idx - idx - 8));
-                } catch (const std::exception &e) {
-                  LOG_PRINT(level, LogLevel::ERROR,
-                            "Failed to count \"binary\" size!");
-                  return {StatusEnum::SE_GENERIC_ERROR, {}};
-                }
-                if (binary_size.value() == 0) {
-                  LOG_PRINT(level, LogLevel::ERROR,
-                            "Failed to count \"binary\" size (parsed as 0)!");
-                  return {StatusEnum::SE_GENERIC_ERROR, {}};
-                }
-                LOG_PRINT(level, LogLevel::DEBUG, "Got binary size {}",
-                          binary_size.value());
-                binary_size_read_start = std::chrono::steady_clock::now();
-              }
-
-              if (str.size() < end_idx + 1 + binary_size.value()) {
-                if (std::chrono::steady_clock::now() -
-                        binary_size_read_start.value() >
-                    MPD_CLI_READ_TIMEOUT) {
-                  // Timed out
-                  return {StatusEnum::SE_READ_TIMED_OUT, {}};
-                }
-                // Did not read enough data, continue reading
-                flags.set(4);
-                std::this_thread::sleep_for(MPD_CLI_READ_BINARY_WAIT);
-                continue;
-              }
-
-              LOG_PRINT(level, LogLevel::VERBOSE, "{}",
-                        str.substr(idx, end_idx - idx));
-              // The only expected binary responses are for album art.
-              parse_for_album_art(str);
-            } else {
-              LOG_PRINT(level, LogLevel::VERBOSE, "binary: ...");
-            }
-          } else {
-            LOG_PRINT(level, LogLevel::VERBOSE, "{}", str);
-          }
-          return {StatusEnum::SE_SUCCESS, std::move(str)};
-        }
-      }
-      cleanup_close_conn();
-      flags.set(0);
-      if (did_write_this_iteration) {
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to read after writing \"{}\"! (errno {})",
-                  to_send, errno);
-      } else {
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Failed to read after writing! (errno {})", errno);
-      }
-      return {StatusEnum::SE_GENERIC_ERROR, {}};
-    } else {
-      cleanup_close_conn();
-      flags.set(0);
-      if (did_write_this_iteration) {
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Read EOF after writing \"{}\"! (errno {})", to_send,
-                  errno);
-      } else {
-        LOG_PRINT(level, LogLevel::ERROR,
-                  "ERROR: Read EOF after writing! (errno {})", errno);
-      }
-      return {StatusEnum::SE_GENERIC_ERROR, {}};
-    }
-  } while (!successful_read);
+  Command background = CMD_NONE;
+  if (album_art_on_main && album_art_needed && !song_filename.empty() &&
+      (!no_readpicture || !no_albumart)) {
+    background = CMD_ALBUM_ART;
+  } else if (!next_song_id.empty() && !next_song_fetched) {
+    background = CMD_NEXT_SONG;
+  } else if (album_art_on_main && next_song_fetched &&
+             !next_album_art_fetched && !next_song_filename.empty()) {
+    background = CMD_NEXT_ALBUM_ART;
+  }
 
-  return {StatusEnum::SE_GENERIC_ERROR, {}};
+  // MPD's changes are only reported while idling, so the song info is
+  // fetched again between background requests once it is old.
+  if (background != CMD_NONE &&
+      std::chrono::steady_clock::now() - status_time >
+          MPD_CLI_STATUS_DEADLINE) {
+    return CMD_STATUS;
+  }
+  return background;
 }
 
-void MPDClient::cleanup_close_conn() {
-  if (conn_socket > 0) {
-    close(conn_socket);
-    conn_socket = -1;
+bool MPDClient::send_binarylimit() {
+  // Set the max binary size:
+  auto [status, str] =
+      write_read(std::format("binarylimit {}\n", binary_limit));
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to set \"binarylimit\"!");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  } else if (str.starts_with("OK")) {
+    // Success.
+    binary_limit_set = true;
+  } else {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to set \"binarylimit\", no OK!");
+    return false;
   }
+
+  return true;
 }
 
-void MPDClient::parse_for_song_info(const std::string &str) {
-  if (!is_ok()) {
-    return;
+bool MPDClient::send_password() {
+  std::string passwd_escaped =
+      helper_replace_in_string(auth_password, "\\", "\\\\");
+  passwd_escaped = helper_replace_in_string(passwd_escaped, "\"", "\\\"");
+  auto [status, str] =
+      write_read(std::format("password \"{}\"\n", passwd_escaped));
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    auth_pending = false;
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to auth with MPD! (check OK)");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
   }
 
-  size_t idx = 0;
+  auth_pending = false;
+  if (str.starts_with("OK")) {
+    // Success, clear "need auth" flag.
+    auth_required = false;
+    password = std::move(auth_password);
+    LOG_PRINT(level, LogLevel::WARNING,
+              "Successfully authenticated with MPD.");
+  } else {
+    // Failed to auth, wait for another password.
+    auth_rejected = true;
+    LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to auth with MPD!");
+  }
+  auth_password.clear();
 
-  while (idx < str.size()) {
-    if (str.size() - idx > 6 &&
-        std::strncmp("Title: ", str.data() + idx, 7) == 0) {
-      idx += 7;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
-      }
-      song_title = std::string(str.data() + idx, end_idx - idx);
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 8 &&
-               std::strncmp("Artist: ", str.data() + idx, 8) == 0) {
-      idx += 8;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+  return true;
+}
+
+bool MPDClient::send_ping() {
+  // Do ping.
+  auto [status, str] = write_read("ping\n");
+
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to ping MPD!");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  } else if (str.starts_with("OK")) {
+    // Success
+    ping_ok = true;
+  } else {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to ping MPD (no OK)!");
+    return false;
+  }
+
+  return true;
+}
+
+bool MPDClient::send_status() {
+  // Once "currentsong" was fetched, "status" alone tells if it needs to be
+  // fetched again, and then it is fetched alone. Otherwise, do "status" and
+  // "currentsong" in one command list. Streams change their tags without a
+  // new song id, so they always get the command list.
+  if (!awaiting_response) {
+    pending_response = PR_SONG_INFO;
+    if (status_ok && !current_song_ok) {
+      song_info_request = SIR_CURRENT_SONG;
+    } else {
+      song_info_request =
+          current_song_ok && song_filename.find("://") == std::string::npos
+              ? SIR_STATUS
+              : SIR_FULL;
+      status_song_id.clear();
+      status_playlist_version.clear();
+      status_next_song_id.clear();
+    }
+  }
+  std::string_view request =
+      "command_list_ok_begin\nstatus\ncurrentsong\ncommand_list_end\n";
+  if (song_info_request == SIR_STATUS) {
+    request = "status\n";
+  } else if (song_info_request == SIR_CURRENT_SONG) {
+    request = "currentsong\n";
+  }
+  auto [status, str] = write_read(request);
+
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to \"status\"/\"currentsong\" MPD!");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  }
+
+  if (str.starts_with("OK")) {
+    // Success, the song info was parsed as it arrived.
+    status_ok = true;
+    if (song_info_request == SIR_STATUS &&
+        (status_song_id != song_id ||
+         status_playlist_version != playlist_version)) {
+      // The song or the queue changed. The rest is updated once
+      // "currentsong" is fetched.
+      current_song_ok = false;
+      return true;
+    }
+    current_song_ok = true;
+    song_id = status_song_id;
+    playlist_version = status_playlist_version;
+    status_time = std::chrono::steady_clock::now();
+    if (status_next_song_id != next_song_id) {
+      next_song_id = status_next_song_id;
+      reset_next_song();
+    }
+  } else if (str.starts_with("ACK ")) {
+    if (str.starts_with("ACK [4@")) {
+      // Permission/Auth required
+      auth_required = true;
+      LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
+      return false;
+    } else {
+      cleanup_close_conn();
+      set_conn_state(CS_FAILED);
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Failed to \"status\"/\"currentsong\" MPD (ACK)!");
+      return false;
+    }
+  } else {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to \"status\"/\"currentsong\" MPD (no OK)!");
+    return false;
+  }
+
+  return true;
+}
+
+bool MPDClient::send_next_song() {
+  // Fetch the next song's info ahead of time.
+  if (!awaiting_response) {
+    pending_response = PR_NEXT_SONG_INFO;
+    next_song_title.clear();
+    next_song_artist.clear();
+    next_song_album.clear();
+    next_song_filename.clear();
+  }
+  auto [status, str] =
+      write_read(std::format("playlistid {}\n", next_song_id));
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to \"playlistid\" MPD!");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  } else if (str.starts_with("ACK [4@")) {
+    // Permission/Auth required
+    auth_required = true;
+    LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
+    return false;
+  } else if (str.starts_with("ACK ")) {
+    // Nothing to prefetch.
+    next_song_filename.clear();
+    LOG_PRINT(level, LogLevel::WARNING,
+              "WARNING: Failed to fetch next song info: {}", str);
+  }
+  next_song_fetched = true;
+
+  return true;
+}
+
+bool MPDClient::update_album_art(const std::string &filename) {
+  if (!awaiting_response && !album_art && partial_album_art.data) {
+    if (partial_album_art.filename == filename) {
+      LOG_PRINT(level, LogLevel::DEBUG,
+                "DEBUG: Resuming album art of \"{}\" at {} of {} bytes.",
+                filename, partial_album_art.offset,
+                partial_album_art.expected_size);
+      album_art = std::move(partial_album_art.data);
+      album_art_offset = partial_album_art.offset;
+      album_art_expected_size = partial_album_art.expected_size;
+      album_art_mime_type = std::move(partial_album_art.mime_type);
+      album_art_chunk_size = 0;
+      no_readpicture = partial_album_art.from_albumart;
+    }
+    // Only the first fetch after reconnecting may continue it.
+    partial_album_art = PartialAlbumArt();
+  }
+
+  if (write_buf.empty() && !awaiting_response && !album_art &&
+      !no_readpicture && !no_albumart) {
+    // First request for this file, skip what didn't work for the songs
+    // before it in the same directory.
+    // "readpicture" is per song, so it is only skipped if the directory's
+    // cover file stands in for it. Without a cover file, the song may still
+    // have an embedded picture.
+    const AlbumArtSource *source = art_cache->find(filename);
+    if (source && source->albumart == AlbumArtSource::MISSING) {
+      LOG_PRINT(level, LogLevel::DEBUG,
+                "DEBUG: No cover file in \"{}\", only trying \"readpicture\".",
+                AlbumArtCache::directory_of(filename));
+      no_albumart = true;
+    } else if (source && source->readpicture == AlbumArtSource::MISSING &&
+               source->albumart == AlbumArtSource::FOUND) {
+      no_readpicture = true;
+    }
+  }
+
+  std::string filename_escaped =
+      helper_replace_in_string(filename, "\\", "\\\\");
+  filename_escaped = helper_replace_in_string(filename_escaped, "\"", "\\\"");
+  std::string_view cmd_name;
+  if (!no_readpicture) {
+    cmd_name = "readpicture";
+  } else if (!no_albumart) {
+    cmd_name = "albumart";
+  } else {
+    finish_album_art(false);
+    return false;
+  }
+
+  // Once the first chunk gave the total and chunk sizes, the remaining chunks
+  // are requested together so that they arrive back to back.
+  size_t offset = album_art_offset.has_value() ? album_art_offset.value() : 0;
+  size_t chunk_count = 1;
+  if (album_art_chunk_size != 0 && album_art_expected_size > offset) {
+    size_t max_chunks = MPD_CLI_ART_PIPELINE_MAX_CHUNKS;
+    if (bytes_per_second > 0.0) {
+      double chunk_seconds =
+          std::chrono::duration<double>(round_trip_time).count() +
+          static_cast<double>(album_art_chunk_size) / bytes_per_second;
+      max_chunks = std::min(
+          max_chunks,
+          static_cast<size_t>(
+              std::chrono::duration<double>(MPD_CLI_ART_PIPELINE_TIME)
+                  .count() /
+              chunk_seconds));
+    }
+    chunk_count = std::min(
+        {(album_art_expected_size - offset + album_art_chunk_size - 1) /
+             album_art_chunk_size,
+         MPD_CLI_ART_PIPELINE_BYTES / album_art_chunk_size, max_chunks});
+    chunk_count = std::max(chunk_count, static_cast<size_t>(1));
+  }
+  std::string cmd;
+  if (chunk_count > 1) {
+    cmd = "command_list_ok_begin\n";
+  }
+  for (size_t idx = 0; idx < chunk_count; ++idx) {
+    cmd += std::format("{} \"{}\" {}\n", cmd_name, filename_escaped,
+                       offset + idx * album_art_chunk_size);
+  }
+  if (chunk_count > 1) {
+    cmd += "command_list_end\n";
+  }
+  if (!awaiting_response) {
+    pending_response = PR_ALBUM_ART_HEADER;
+    album_art_request_offset = offset;
+  }
+  auto [status, buf] = write_read(cmd);
+  if (is_status_eagain(status) && is_ok()) {
+    return false;
+  } else if (!is_ok() || status != SE_SUCCESS) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Internal error while fetching album art from MPD!");
+    save_partial_album_art();
+    finish_album_art(false);
+    return false;
+  } else if (buf.starts_with("ACK [4@")) {
+    // Permission/Auth required
+    auth_required = true;
+    LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPD requires auth!");
+    return false;
+  } else if (buf.starts_with("ACK ") || album_art_expected_size == 0) {
+    // MPD may reply with an empty "OK" if there is no picture.
+    if (!no_readpicture) {
+      no_readpicture = true;
+      art_cache->record(filename, false, false, 0);
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: song has no embedded album art!");
+      if (art_cache->find(filename)->albumart == AlbumArtSource::MISSING) {
+        no_albumart = true;
+        finish_album_art(false);
+        return false;
       }
-      song_artist = std::string(str.data() + idx, end_idx - idx);
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 7 &&
-               std::strncmp("Album: ", str.data() + idx, 7) == 0) {
-      idx += 7;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+    } else if (!no_albumart) {
+      no_albumart = true;
+      art_cache->record(filename, true, false, 0);
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: song has no cover image!");
+      if (no_readpicture && no_albumart) {
+        finish_album_art(false);
+        return false;
       }
-      song_album = std::string(str.data() + idx, end_idx - idx);
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 6 &&
-               std::strncmp("file: ", str.data() + idx, 6) == 0) {
-      idx += 6;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+    } else {
+      finish_album_art(false);
+      return false;
+    }
+  } else if (album_art && album_art_offset.has_value() &&
+             album_art_offset.value() == album_art_expected_size) {
+    LOG_PRINT(level, LogLevel::DEBUG,
+              "DEBUG: Fetched \"readpicture/albumart\" data. (size {})",
+              album_art->size());
+    art_cache->record(filename, no_readpicture, true, album_art_expected_size);
+    if (no_readpicture) {
+      art_cache->set_recent_art(filename, album_art, album_art_mime_type);
+    }
+    finish_album_art(true);
+  } else if (no_readpicture && album_art && album_art_offset.has_value() &&
+             album_art_request_offset == 0) {
+    // Only the first chunk is fetched so far. "albumart" returns the same
+    // cover file for every song in a directory, so it's not fetched again if
+    // it matches the last one.
+    auto same_art = art_cache->find_same_art(
+        filename, album_art_expected_size,
+        std::string_view(album_art->data(), album_art_offset.value()),
+        album_art_mime_type);
+    if (same_art) {
+      LOG_PRINT(level, LogLevel::DEBUG,
+                "DEBUG: Album art of \"{}\" is the same as the last one.",
+                filename);
+      album_art = std::move(same_art);
+      finish_album_art(true);
+    }
+  }
+
+  return true;
+}
+
+void MPDClient::finish_album_art(bool fetched) {
+  if (album_art_for_next_song) {
+    album_art_for_next_song = false;
+    next_album_art_fetched = true;
+    if (fetched) {
+      next_album_art = album_art;
+      next_album_art_mime_type = album_art_mime_type;
+    }
+  } else {
+    album_art_needed = false;
+    if (fetched) {
+      fetched_album_art = album_art;
+      fetched_album_art_mime_type = album_art_mime_type;
+    } else {
+      album_art_failed = true;
+    }
+  }
+
+  // The fetched data is shared from here on, later fetches use a new buffer.
+  album_art.reset();
+  album_art_offset = std::nullopt;
+  album_art_expected_size = 0;
+  album_art_chunk_size = 0;
+  album_art_mime_type.clear();
+}
+
+void MPDClient::reset_next_song() {
+  if (album_art_for_next_song) {
+    // Drop the partially fetched album art.
+    album_art_for_next_song = false;
+    discard_album_art();
+  }
+  next_song_fetched = false;
+  next_album_art_fetched = false;
+  next_song_title.clear();
+  next_song_artist.clear();
+  next_song_album.clear();
+  next_song_filename.clear();
+  next_album_art.reset();
+  next_album_art_mime_type.clear();
+}
+
+void MPDClient::update_art_client() {
+  if (is_art_client || album_art_on_main) {
+    return;
+  }
+
+  // "art_client" is still updated while this connection isn't ready, so that
+  // it doesn't keep waking up "wait_for_io()".
+  const std::string *wanted = nullptr;
+  bool for_next_song = false;
+  if (!is_ok() || !ping_ok || auth_required) {
+    // Not ready for album art.
+  } else if (album_art_needed && !song_filename.empty()) {
+    wanted = &song_filename;
+  } else if (next_song_fetched && !next_album_art_fetched &&
+             !next_song_filename.empty()) {
+    wanted = &next_song_filename;
+    for_next_song = true;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!art_client) {
+    if (!wanted || now < art_client_retry_time) {
+      return;
+    }
+    LOG_PRINT(level, LogLevel::DEBUG, "DEBUG: Opening album art connection.");
+    art_client = std::make_unique<MPDClient>(
+        is_unix_socket ? socket_path : host_name, host_port, level,
+        is_unix_socket, connect_timeout, heartbeat_interval);
+    art_client->is_art_client = true;
+    art_client->art_cache = art_cache;
+    art_client->trace = trace;
+    art_client->use_io_uring = use_io_uring;
+  }
+
+  if (wanted) {
+    if (art_client->song_filename != *wanted ||
+        (!for_next_song && album_art_refetch &&
+         !art_client->is_fetching_album_art())) {
+      art_client->fetch_album_art(*wanted);
+      if (partial_album_art.data && partial_album_art.filename == *wanted) {
+        art_client->partial_album_art =
+            std::exchange(partial_album_art, PartialAlbumArt());
       }
-      std::string song_filename = std::string(str.data() + idx, end_idx - idx);
-      if (song_filename != this->song_filename) {
-        // New song, info is stale.
-        request_data_update();
-        request_refetch_album_art();
-        this->song_filename = song_filename;
+    }
+    if (!for_next_song) {
+      album_art_refetch = false;
+    }
+  }
+
+  if (art_client->needs_auth() && !art_client->is_authenticating()) {
+    if (password.empty() || art_client->auth_failed()) {
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: Album art connection failed to authenticate, "
+                "fetching album art on the main connection.");
+      art_client.reset();
+      album_art_on_main = true;
+      return;
+    }
+    art_client->attempt_auth(password);
+  }
+
+  art_client->update();
+  if (!art_client->is_ok()) {
+    if (art_client->ping_success()) {
+      // It worked before, try again later.
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: Album art connection lost!");
+      art_client_retry_time = now + MPD_CLI_ART_RECONNECT_DELAY;
+    } else {
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: Failed to open album art connection, fetching album "
+                "art on the main connection.");
+      album_art_on_main = true;
+    }
+    PartialAlbumArt partial = art_client->take_partial_album_art();
+    if (partial.data) {
+      partial_album_art = std::move(partial);
+    }
+    art_client.reset();
+    return;
+  }
+
+  if (wanted && art_client->song_filename == *wanted &&
+      !art_client->is_fetching_album_art()) {
+    if (for_next_song) {
+      next_album_art_fetched = true;
+      next_album_art = art_client->fetched_album_art;
+      next_album_art_mime_type = art_client->fetched_album_art_mime_type;
+    } else {
+      album_art_needed = false;
+      album_art_failed = !art_client->fetched_album_art;
+      fetched_album_art = art_client->fetched_album_art;
+      fetched_album_art_mime_type = art_client->fetched_album_art_mime_type;
+    }
+  }
+}
+
+void MPDClient::fetch_album_art(const std::string &filename) {
+  song_filename = filename;
+  // Fetched again even if it is the same file, see "update_step()".
+  album_art_filename.clear();
+}
+
+const std::string &MPDClient::get_song_title() const { return song_title; }
+const std::string &MPDClient::get_song_artist() const { return song_artist; }
+const std::string &MPDClient::get_song_album() const { return song_album; }
+const std::string &MPDClient::get_song_filename() const {
+  return song_filename;
+}
+double MPDClient::get_song_duration() const { return song_duration; }
+std::tuple<double, std::chrono::steady_clock::time_point>
+MPDClient::get_elapsed_time() const {
+  return {elapsed_time, elapsed_time_point};
+}
+std::shared_ptr<const std::vector<char> > MPDClient::get_album_art() const {
+  return fetched_album_art;
+}
+const std::string &MPDClient::get_album_art_mime_type() const {
+  return fetched_album_art_mime_type;
+}
+
+const std::string &MPDClient::get_next_song_title() const {
+  return next_song_title;
+}
+const std::string &MPDClient::get_next_song_artist() const {
+  return next_song_artist;
+}
+const std::string &MPDClient::get_next_song_album() const {
+  return next_song_album;
+}
+const std::string &MPDClient::get_next_song_filename() const {
+  return next_song_filename;
+}
+std::shared_ptr<const std::vector<char> > MPDClient::get_next_album_art()
+    const {
+  return next_album_art;
+}
+const std::string &MPDClient::get_next_album_art_mime_type() const {
+  return next_album_art_mime_type;
+}
+
+const std::string &MPDClient::get_play_state() const { return mpd_play_state; }
+
+bool MPDClient::song_has_album_art() const { return !album_art_failed; }
+
+void MPDClient::request_data_update() { status_ok = false; }
+
+void MPDClient::request_refetch_album_art() {
+  // The data may be bad, don't reuse it.
+  art_cache->forget_recent_art();
+  start_album_art_fetch();
+}
+
+bool MPDClient::ping_success() const { return ping_ok; }
+
+void MPDClient::start_album_art_fetch() {
+  album_art_needed = true;
+  album_art_refetch = true;
+  // Takes priority over prefetching the next song's album art.
+  album_art_for_next_song = false;
+  fetched_album_art.reset();
+  fetched_album_art_mime_type.clear();
+  album_art.reset();
+  album_art_expected_size = 0;
+  album_art_chunk_size = 0;
+  album_art_mime_type.clear();
+  album_art_offset = 0;
+  no_readpicture = false;
+  no_albumart = false;
+  album_art_failed = false;
+}
+
+bool MPDClient::is_fetching_album_art() const {
+  return album_art_needed || song_filename != album_art_filename;
+}
+
+size_t MPDClient::get_binary_limit() const { return binary_limit; }
+
+size_t MPDClient::choose_binary_limit(
+    double bytes_per_second, std::chrono::microseconds round_trip_time) {
+  // Every chunk costs a round trip on top of its transfer, but a slow link
+  // still gets some payload per chunk.
+  std::chrono::microseconds budget =
+      std::max(std::chrono::duration_cast<std::chrono::microseconds>(
+                   MPD_CLI_ART_CHUNK_TARGET) -
+                   round_trip_time,
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                   MPD_CLI_ART_CHUNK_TARGET / 4));
+  double limit =
+      bytes_per_second * std::chrono::duration<double>(budget).count();
+  if (!(limit < static_cast<double>(MPD_BINARY_LIMIT))) {
+    return MPD_BINARY_LIMIT;
+  } else if (limit < static_cast<double>(MPD_BINARY_LIMIT_MIN)) {
+    return MPD_BINARY_LIMIT_MIN;
+  }
+  // Rounded down to whole KiB.
+  return std::max(static_cast<size_t>(limit) / 1024 * 1024,
+                  MPD_BINARY_LIMIT_MIN);
+}
+
+bool MPDClient::is_status_eagain(StatusEnum status) {
+  return status == StatusEnum::SE_EAGAIN_ON_READ ||
+         status == StatusEnum::SE_EAGAIN_ON_WRITE;
+}
+
+std::tuple<MPDClient::StatusEnum, std::string_view> MPDClient::write_read(
+    std::string_view to_send) {
+  if (!is_ok() || conn_socket < 0) {
+    return {StatusEnum::SE_GENERIC_ERROR, {}};
+  }
+
+  // The previously returned response is no longer needed.
+  if (response_size != 0) {
+    recv_buf.consume(response_size);
+    response_size = 0;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+
+  if (!awaiting_response) {
+    if (write_buf.empty()) {
+      // New request.
+      if (to_send.starts_with("password ")) {
+        LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: sending: password");
+      } else {
+        LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: sending: {:.{}}",
+                  to_send.empty() ? "Nothing" : to_send,
+                  to_send.empty() ? 7 : to_send.size() - 1);
       }
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 10 &&
-               std::strncmp("duration: ", str.data() + idx, 10) == 0) {
-      idx += 10;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+      write_buf.assign(to_send);
+      parser.reset();
+      io_deadline = now + MPD_CLI_WRITE_TIMEOUT;
+      request_time = now;
+      request_bytes = 0;
+      request_chunks = 0;
+    }
+
+    // Sent right away without polling first, "EAGAIN" means it's not
+    // writable.
+    while (!write_buf.empty()) {
+      ssize_t write_ret;
+      if (uring.is_open()) {
+        std::optional<int> sent = uring.take_send_result();
+        if (sent.has_value() && std::exchange(uring_sending_noidle, false)) {
+          // That was "noidle" from "update_idle()", "write_buf" is next.
+          if (sent.value() == static_cast<int>(NOIDLE_CMD.size())) {
+            continue;
+          }
+          write_ret = -1;
+          errno = sent.value() < 0 ? -sent.value() : EIO;
+        } else if (sent.has_value()) {
+          write_ret = sent.value() < 0 ? -1 : sent.value();
+          errno = sent.value() < 0 ? -sent.value() : 0;
+        } else if (uring.is_sending() || uring.start_send(write_buf)) {
+          write_ret = -1;
+          errno = EAGAIN;
+        } else {
+          write_ret = -1;
+        }
+      } else {
+        write_ret = send(conn_socket, write_buf.data(), write_buf.size(),
+                         MSG_NOSIGNAL);
       }
-      std::string song_duration_str =
-          std::string(str.data() + idx, end_idx - idx);
-      try {
-        song_duration = std::stod(song_duration_str);
-      } catch (const std::exception &e) {
-        LOG_PRINT(level, LogLevel::WARNING,
-                  "WARNING: Failed to parse song duration! {}",
-                  song_duration_str);
+      if (write_ret > 0) {
+        trace_sent(std::string_view(write_buf).substr(
+            0, static_cast<size_t>(write_ret)));
+        write_buf.erase(0, static_cast<size_t>(write_ret));
+      } else if (write_ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (now > io_deadline) {
+          LOG_PRINT(level, LogLevel::WARNING,
+                    "WARNING: MPDCli write timed out!");
+          write_buf.clear();
+          return {StatusEnum::SE_WRITE_TIMED_OUT, {}};
+        }
+        return {StatusEnum::SE_EAGAIN_ON_WRITE, {}};
+      } else {
+        cleanup_close_conn();
+        set_conn_state(CS_FAILED);
+        LOG_PRINT(level, LogLevel::ERROR,
+                  "ERROR: Failed to write \"{}\"! (errno {})", write_buf,
+                  errno);
+        write_buf.clear();
+        return {StatusEnum::SE_GENERIC_ERROR, {}};
       }
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 9 &&
-               std::strncmp("elapsed: ", str.data() + idx, 9) == 0) {
-      elapsed_time_point = std::chrono::steady_clock::now();
-      idx += 9;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+    }
+
+    // Success.
+    awaiting_response = true;
+    io_deadline = now + MPD_CLI_READ_TIMEOUT;
+    LOG_PRINT(level, LogLevel::VERBOSE,
+              "VERBOSE: write_read: read after write...");
+  }
+
+  // Read without polling first, until a read comes back short (the socket is
+  // drained) or fails with "EAGAIN".
+  bool drained = false;
+  while (true) {
+    // Handle what has been received so far before reading more.
+    std::string_view str = recv_buf.view();
+    ResponseParser::Event event;
+    while ((event = parser.next(str)).type != ResponseParser::EV_NEED_MORE) {
+      handle_response_event(event);
+      if (parser.done()) {
+        measure_request();
+        // Keep the last line until the next call, it is returned.
+        awaiting_response = false;
+        pending_response = PR_NONE;
+        response_size = parser.take_parsed();
+        LOG_PRINT(level, LogLevel::VERBOSE, "{}", event.value);
+        return {StatusEnum::SE_SUCCESS, event.value};
       }
-      std::string song_elapsed_str =
-          std::string(str.data() + idx, end_idx - idx);
-      try {
-        elapsed_time = std::stod(song_elapsed_str);
-      } catch (const std::exception &e) {
-        LOG_PRINT(level, LogLevel::WARNING,
-                  "WARNING: Failed to parse song elapsed! {}",
-                  song_elapsed_str);
+    }
+    recv_buf.consume(parser.take_parsed());
+
+    if (drained) {
+      break;
+    }
+
+    ssize_t read_ret;
+    size_t read_size;
+    std::string_view payload_read;
+    if (pending_response == PR_ALBUM_ART_PAYLOAD &&
+        parser.binary_remaining() > 0) {
+      // Album art payload is read directly into its final buffer. What
+      // follows it (the next chunk header in a command list) is read with
+      // the same call.
+      size_t payload_size = parser.binary_remaining();
+      read_size = payload_size +
+                  std::min(READ_BUF_SIZE_SMALL,
+                           recv_buf.capacity() - recv_buf.size());
+      read_ret = receive(album_art->data() + album_art_offset.value(),
+                         payload_size, read_size - payload_size);
+      if (read_ret > 0) {
+        payload_read = std::string_view(
+            album_art->data() + album_art_offset.value(),
+            std::min(static_cast<size_t>(read_ret), payload_size));
+        album_art_offset.value() += payload_read.size();
+        parser.skip_binary(payload_read.size());
       }
-      idx = end_idx + 1;
-    } else if (str.size() - idx > 7 &&
-               std::strncmp("state: ", str.data() + idx, 7) == 0) {
-      idx += 7;
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
-        break;
+    } else if (recv_buf.full()) {
+      cleanup_close_conn();
+      set_conn_state(CS_FAILED);
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Line from MPD is longer than {} bytes!",
+                recv_buf.capacity());
+      return {StatusEnum::SE_GENERIC_ERROR, {}};
+    } else if (pending_response == PR_ALBUM_ART_HEADER) {
+      // Only the small chunk header is wanted in "recv_buf".
+      read_size = std::min(READ_BUF_SIZE_SMALL,
+                           recv_buf.capacity() - recv_buf.size());
+      read_ret = receive(nullptr, 0, read_size);
+    } else {
+      read_size = recv_buf.capacity() - recv_buf.size();
+      read_ret = receive(nullptr, 0, read_size);
+    }
+
+    if (read_ret > 0) {
+      drained = static_cast<size_t>(read_ret) < read_size;
+      trace_received(payload_read,
+                     static_cast<size_t>(read_ret) - payload_read.size());
+      LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Read {} bytes...",
+                read_ret);
+      // Data is arriving, so push back the deadline.
+      io_deadline = now + MPD_CLI_READ_TIMEOUT;
+      last_heard_time = now;
+      if (request_bytes == 0) {
+        request_latency =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - request_time);
       }
-      mpd_play_state = std::string(str.data() + idx, end_idx - idx);
-      idx = end_idx + 1;
+      request_bytes += static_cast<size_t>(read_ret);
+    } else if (read_ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
     } else {
-      size_t end_idx = str.find("\n", idx);
-      if (end_idx == std::string::npos) {
+      cleanup_close_conn();
+      set_conn_state(CS_FAILED);
+      log_connection_lost();
+      if (read_ret == 0) {
+        LOG_PRINT(level, LogLevel::ERROR,
+                  "ERROR: Read EOF after writing! (errno {})", errno);
+      } else {
+        LOG_PRINT(level, LogLevel::ERROR,
+                  "ERROR: Failed to read after writing! (errno {})", errno);
+      }
+      return {StatusEnum::SE_GENERIC_ERROR, {}};
+    }
+  }
+
+  // Timeouts don't apply to a pending "idle" unless "noidle" was sent.
+  if (idle_state != IS_IDLE && now > io_deadline) {
+    LOG_PRINT(level, LogLevel::WARNING, "WARNING: MPDCli read timed out!");
+    log_connection_lost();
+    awaiting_response = false;
+    pending_response = PR_NONE;
+    recv_buf.clear();
+    parser.reset();
+    return {StatusEnum::SE_READ_TIMED_OUT, {}};
+  }
+  return {StatusEnum::SE_EAGAIN_ON_READ, {}};
+}
+
+ssize_t MPDClient::receive(char *front, size_t front_size, size_t max_size) {
+  if (!uring.is_open()) {
+    return recv_buf.read_from(conn_socket, front, front_size, max_size);
+  } else if (recv_buf.full() && front_size == 0) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  size_t total = 0;
+  std::string_view data;
+  while (total < front_size + max_size &&
+         !(data = uring.received()).empty()) {
+    size_t taken;
+    if (total < front_size) {
+      taken = std::min(data.size(), front_size - total);
+      std::memcpy(front + total, data.data(), taken);
+    } else {
+      taken = recv_buf.append(data.substr(0, front_size + max_size - total));
+      if (taken == 0) {
         break;
       }
-      idx = end_idx + 1;
     }
+    uring.consume(taken);
+    total += taken;
+  }
+  if (total > 0) {
+    return static_cast<ssize_t>(total);
+  }
+
+  // Nothing received, so report it like "recv()" would.
+  const int status = uring.get_recv_status();
+  if (status > 0) {
+    errno = EAGAIN;
+    return -1;
+  } else if (status == 0) {
+    return 0;
   }
+  errno = -status;
+  return -1;
 }
 
-void MPDClient::parse_for_album_art(const std::string &buf) {
-  if (!is_ok() || !album_art_offset.has_value() || !flags.test(8)) {
+void MPDClient::measure_request() {
+  if (idle_state != IS_NONE ||
+      (pending_response != PR_ALBUM_ART_HEADER &&
+       pending_response != PR_ALBUM_ART_PAYLOAD) ||
+      request_bytes == 0) {
     return;
   }
 
-  size_t idx = 0;
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - request_time);
+  round_trip_time = round_trip_time.count() == 0
+                        ? request_latency
+                        : (round_trip_time + request_latency) / 2;
+  if (request_bytes < MPD_BINARY_LIMIT_MIN) {
+    // Too little to tell the throughput.
+    return;
+  }
+
+  // Every chunk in a command list costs MPD another read of the picture, the
+  // rest of the time is the transfer.
+  auto transfer_time = std::max(
+      elapsed - round_trip_time * static_cast<int64_t>(
+                                      std::max(request_chunks,
+                                               static_cast<size_t>(1))),
+      std::chrono::microseconds(100));
+  double sample = static_cast<double>(request_bytes) /
+                  std::chrono::duration<double>(transfer_time).count();
+  bytes_per_second = bytes_per_second == 0.0
+                         ? sample
+                         : (bytes_per_second + sample) / 2.0;
+
+  size_t limit = choose_binary_limit(bytes_per_second, round_trip_time);
+  LOG_PRINT(level, LogLevel::DEBUG,
+            "DEBUG: Album art throughput {:.0f} KiB/s, round trip {} us, "
+            "binarylimit {} (best {})",
+            bytes_per_second / 1024.0, round_trip_time.count(), binary_limit,
+            limit);
+  // Only changed when off by more than a third, to not resend it every time.
+  if (limit * 3 < binary_limit * 2 || limit * 2 > binary_limit * 3) {
+    LOG_PRINT(level, LogLevel::DEBUG, "DEBUG: Changing binarylimit to {}",
+              limit);
+    binary_limit = limit;
+    binary_limit_set = false;
+    // The chunk stride is learned again from the next chunk.
+    album_art_chunk_size = 0;
+  }
+}
+
+void MPDClient::handle_response_event(const ResponseParser::Event &event) {
+  if (event.type == ResponseParser::EV_KEY_VALUE) {
+    LOG_PRINT(level, LogLevel::VERBOSE, "{}: {}", event.key, event.value);
+  }
 
-  size_t binary_size_idx = buf.find("\nbinary: ");
-  if (binary_size_idx == std::string::npos) {
+  if (idle_state != IS_NONE) {
+    parse_for_idle_changes(event);
+  } else if (pending_response == PR_ALBUM_ART_HEADER ||
+             pending_response == PR_ALBUM_ART_PAYLOAD) {
+    parse_for_album_art(event);
+  } else if (pending_response == PR_SONG_INFO) {
+    parse_for_song_info(event);
+  } else if (pending_response == PR_NEXT_SONG_INFO) {
+    parse_for_next_song_info(event);
+  }
+}
+
+void MPDClient::wait_for_io(int wake_fd, int timeout_ms) const {
+  struct pollfd pfds[1 + 2 * MPD_CLI_MAX_CONNECT_ATTEMPTS];
+  nfds_t count = 0;
+  if (wake_fd >= 0) {
+    pfds[count].fd = wake_fd;
+    pfds[count].events = POLLIN;
+    pfds[count].revents = 0;
+    ++count;
+  }
+
+  if (!add_poll_fds(pfds, count, timeout_ms) ||
+      (art_client && !art_client->add_poll_fds(pfds, count, timeout_ms))) {
     return;
   }
-  ++binary_size_idx;
 
-  if (album_art_expected_size == 0) {
-    idx = buf.find("size: ");
-    if (idx == std::string::npos || idx >= binary_size_idx) {
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to parse albumart size!");
-      return;
+  int ret;
+  do {
+    ret = poll(pfds, count, timeout_ms);
+  } while (ret < 0 && errno == EINTR);
+}
+
+bool MPDClient::add_poll_fds(struct pollfd *pfds, nfds_t &count,
+                             int &timeout_ms) const {
+  if (conn_state == CS_RESOLVING) {
+    // The resolver runs on its own thread, check back on it soon.
+    const int poll_ms =
+        static_cast<int>(MPD_CLI_RESOLVE_POLL_INTERVAL.count());
+    if (timeout_ms < 0 || poll_ms < timeout_ms) {
+      timeout_ms = poll_ms;
     }
-    size_t newline_idx = buf.find('\n', idx);
-    if (newline_idx == std::string::npos || newline_idx >= binary_size_idx) {
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to parse albumart size!");
-      return;
+  } else if (conn_state == CS_CONNECTING) {
+    if (connect_sockets.empty()) {
+      // The next address can be tried right away.
+      return false;
     }
-    std::string size_str(buf.substr(idx + 6, newline_idx - idx - 6));
-    try {
-      album_art_expected_size = std::stoull(size_str);
-    } catch (const std::exception &e) {
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to parse albumart size!");
-      return;
+    for (int fd : connect_sockets) {
+      pfds[count].fd = fd;
+      pfds[count].events = POLLOUT;
+      pfds[count].revents = 0;
+      ++count;
+    }
+    if (connect_addrs_idx < connect_addrs.size()) {
+      // Wake up in time to race the next address.
+      auto until_next = std::chrono::duration_cast<std::chrono::milliseconds>(
+          connect_attempt_time + MPD_CLI_CONNECT_ATTEMPT_DELAY -
+          std::chrono::steady_clock::now());
+      const int next_ms = std::max(0, static_cast<int>(until_next.count()) + 1);
+      if (timeout_ms < 0 || next_ms < timeout_ms) {
+        timeout_ms = next_ms;
+      }
+    }
+  } else if (is_ok() && conn_socket >= 0) {
+    if (uring.has_received()) {
+      // Received already, not read from the socket again.
+      return false;
+    } else if (!write_buf.empty() && !awaiting_response) {
+      // "uring" sends on its own, its completion makes its fd readable.
+      pfds[count].fd = uring.is_open() ? uring.get_fd() : conn_socket;
+      pfds[count].events = uring.is_open() ? POLLIN : POLLOUT;
+      pfds[count].revents = 0;
+      ++count;
+    } else if (awaiting_response && idle_state == IS_IDLE &&
+               has_pending_work()) {
+      // "idle" finished sending after "update()" looked for work to
+      // interrupt it with, which it can do right away.
+      return false;
+    } else if (awaiting_response) {
+      pfds[count].fd = uring.is_open() ? uring.get_fd() : conn_socket;
+      pfds[count].events = POLLIN;
+      pfds[count].revents = 0;
+      ++count;
+      if (idle_state == IS_IDLE) {
+        // Wake up in time for the heartbeat.
+        auto until_heartbeat =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                last_heard_time + heartbeat_interval -
+                std::chrono::steady_clock::now());
+        const int heartbeat_ms =
+            std::max(0, static_cast<int>(until_heartbeat.count()) + 1);
+        if (timeout_ms < 0 || heartbeat_ms < timeout_ms) {
+          timeout_ms = heartbeat_ms;
+        }
+      }
+    } else if (!auth_required || auth_pending) {
+      // Nothing in flight, "update()" can send the next request right away.
+      return false;
     }
   }
+  return true;
+}
 
-  if (album_art_mime_type.empty()) {
-    idx = buf.find("type: ");
-    if (idx == std::string::npos || idx >= binary_size_idx) {
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to parse albumart mime-type!");
-      return;
+void MPDClient::start_connect_attempt(const SockAddr &addr) {
+  int fd = socket(addr.addr.ss_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    connect_errno = errno;
+    LOG_PRINT(level, LogLevel::VERBOSE,
+              "VERBOSE: Failed to create socket: errno {}", errno);
+    return;
+  }
+
+  // Set before "connect()" so an unreachable address can't block until the
+  // kernel gives up on it.
+  if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+    connect_errno = errno;
+    close(fd);
+    LOG_PRINT(level, LogLevel::VERBOSE,
+              "VERBOSE: Failed to set non-blocking on socket! errno {}",
+              errno);
+    return;
+  }
+
+  int connect_ret =
+      connect(fd, reinterpret_cast<const struct sockaddr *>(&addr.addr),
+              addr.len);
+  if (connect_ret != 0 && errno != EINPROGRESS) {
+    connect_errno = errno;
+    close(fd);
+    LOG_PRINT(level, LogLevel::VERBOSE,
+              "VERBOSE: Connect attempt (family {}) failed: errno {}",
+              addr.addr.ss_family, errno);
+    return;
+  }
+
+  // Even if already connected, "check_connect()" picks it up.
+  connect_sockets.push_back(fd);
+}
+
+bool MPDClient::check_connect() {
+  const auto now = std::chrono::steady_clock::now();
+
+  // Each attempt gets a head start before the next address races it.
+  while (connect_addrs_idx < connect_addrs.size() &&
+         connect_sockets.size() < MPD_CLI_MAX_CONNECT_ATTEMPTS &&
+         (connect_sockets.empty() ||
+          now - connect_attempt_time >= MPD_CLI_CONNECT_ATTEMPT_DELAY)) {
+    connect_attempt_time = now;
+    start_connect_attempt(connect_addrs[connect_addrs_idx++]);
+  }
+
+  struct pollfd pfds[MPD_CLI_MAX_CONNECT_ATTEMPTS];
+  nfds_t count = 0;
+  for (int fd : connect_sockets) {
+    pfds[count].fd = fd;
+    pfds[count].events = POLLOUT;
+    pfds[count].revents = 0;
+    ++count;
+  }
+
+  int ret = 0;
+  if (count > 0) {
+    do {
+      ret = poll(pfds, count, 0);
+    } while (ret < 0 && errno == EINTR);
+  }
+
+  for (nfds_t idx = 0; ret > 0 && idx < count; ++idx) {
+    if (pfds[idx].revents == 0) {
+      continue;
     }
-    size_t newline_idx = buf.find('\n', idx);
-    if (newline_idx == std::string::npos || newline_idx >= binary_size_idx) {
-      LOG_PRINT(level, LogLevel::ERROR,
-                "ERROR: Failed to parse albumart mime-type!");
-      return;
+
+    int so_error = 0;
+    socklen_t so_error_len = sizeof(so_error);
+    if (getsockopt(pfds[idx].fd, SOL_SOCKET, SO_ERROR, &so_error,
+                   &so_error_len) != 0) {
+      so_error = errno;
+    } else if (so_error == 0 &&
+               (pfds[idx].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+      so_error = ECONNREFUSED;
+    }
+
+    connect_sockets.erase(std::find(connect_sockets.begin(),
+                                    connect_sockets.end(), pfds[idx].fd));
+    if (so_error == 0) {
+      // The first attempt to finish wins, the rest are dropped.
+      conn_socket = pfds[idx].fd;
+      for (int fd : connect_sockets) {
+        close(fd);
+      }
+      connect_sockets.clear();
+      if (!is_unix_socket) {
+        set_tcp_options();
+      }
+      if (trace) {
+        trace_connection = trace->new_connection();
+      }
+      last_heard_time = now;
+      return true;
     }
-    album_art_mime_type = buf.substr(idx + 6, newline_idx - idx - 6);
-  }
 
-  if (!album_art.has_value()) {
-    album_art = std::vector<char>{};
+    connect_errno = so_error;
+    close(pfds[idx].fd);
   }
 
-  size_t newline_idx = buf.find('\n', binary_size_idx);
-  if (newline_idx == std::string::npos) {
+  if (connect_sockets.empty() && connect_addrs_idx >= connect_addrs.size()) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
     LOG_PRINT(level, LogLevel::ERROR,
-              "ERROR: Failed to parse albumart chunk size!");
+              "ERROR: Failed to connect to host! errno {}", connect_errno);
+  } else if (now > io_deadline) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Timed out connecting to host after {} milliseconds!",
+              connect_timeout.count());
+  }
+  return false;
+}
+
+void MPDClient::set_tcp_options() {
+  const int enable = 1;
+  if (setsockopt(conn_socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+                 sizeof(enable)) != 0) {
+    LOG_PRINT(level, LogLevel::WARNING,
+              "WARNING: Failed to set TCP_NODELAY! errno {}", errno);
+  }
+
+  const int keepalive_idle = std::max(
+      1, static_cast<int>(
+             std::chrono::ceil<std::chrono::seconds>(heartbeat_interval)
+                 .count()));
+  const int keepalive_interval = MPD_CLI_KEEPALIVE_INTERVAL_SECS;
+  const int keepalive_count = MPD_CLI_KEEPALIVE_COUNT;
+  if (setsockopt(conn_socket, SOL_SOCKET, SO_KEEPALIVE, &enable,
+                 sizeof(enable)) != 0 ||
+      setsockopt(conn_socket, IPPROTO_TCP, TCP_KEEPIDLE, &keepalive_idle,
+                 sizeof(keepalive_idle)) != 0 ||
+      setsockopt(conn_socket, IPPROTO_TCP, TCP_KEEPINTVL, &keepalive_interval,
+                 sizeof(keepalive_interval)) != 0 ||
+      setsockopt(conn_socket, IPPROTO_TCP, TCP_KEEPCNT, &keepalive_count,
+                 sizeof(keepalive_count)) != 0) {
+    LOG_PRINT(level, LogLevel::WARNING,
+              "WARNING: Failed to set TCP keepalive! errno {}", errno);
+  }
+}
+
+void MPDClient::log_connection_lost() const {
+  LOG_PRINT(level, LogLevel::DEBUG,
+            "DEBUG: Lost connection to MPD, {} ms after last hearing from it",
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - last_heard_time)
+                .count());
+}
+
+void MPDClient::trace_sent(std::string_view data) {
+  if (!trace) {
     return;
+  } else if (current_command == CMD_PASSWORD) {
+    // The password is left out of the trace.
+    data = "password\n";
   }
-  std::string chunk_str =
-      buf.substr(binary_size_idx + 8, newline_idx - binary_size_idx - 8);
-  size_t chunk_size;
-  try {
-    chunk_size = std::stoull(chunk_str);
-  } catch (const std::exception &e) {
-    LOG_PRINT(level, LogLevel::ERROR,
-              "ERROR: Failed to parse albumart chunk size!");
+  trace->record(trace_connection, ProtocolTrace::DIR_SENT, data);
+}
+
+void MPDClient::trace_received(std::string_view front, size_t buffered) {
+  if (!trace) {
     return;
   }
-  if (chunk_size == 0) {
-    LOG_PRINT(
-        level, LogLevel::ERROR,
-        "ERROR: Failed to parse albumart chunk size! (chunk_size is zero)");
+  std::string_view received = recv_buf.view();
+  received = received.substr(received.size() - buffered);
+  if (front.empty()) {
+    trace->record(trace_connection, ProtocolTrace::DIR_RECEIVED, received);
+  } else {
+    std::string data(front);
+    data.append(received);
+    trace->record(trace_connection, ProtocolTrace::DIR_RECEIVED, data);
+  }
+}
+
+void MPDClient::cleanup_close_conn() {
+  uring.close();
+  uring_sending_noidle = false;
+  if (conn_socket > 0) {
+    close(conn_socket);
+    conn_socket = -1;
+  }
+  for (int fd : connect_sockets) {
+    close(fd);
+  }
+  connect_sockets.clear();
+}
+
+bool MPDClient::has_pending_work() const {
+  if (is_art_client) {
+    return is_fetching_album_art();
+  }
+  return next_command() != CMD_NONE;
+}
+
+void MPDClient::enter_idle() {
+  if (!is_ok() || conn_socket < 0 || idle_state != IS_NONE) {
     return;
   }
 
-  size_t chunk_start_idx = newline_idx + 1;
-  album_art.value().insert(
-      album_art.value().end(),
-      buf.begin() + static_cast<ssize_t>(chunk_start_idx),
-      buf.begin() + static_cast<ssize_t>(chunk_start_idx + chunk_size));
+  idle_state = IS_IDLE;
+  LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: Entering idle.");
+  update_idle();
+}
 
-  if (!album_art_offset.has_value()) {
-    album_art_offset = chunk_size;
-  } else {
-    album_art_offset.value() += chunk_size;
+bool MPDClient::update_idle() {
+  if (!is_ok() || conn_socket < 0) {
+    idle_state = IS_NONE;
+    return true;
   }
+
+  const bool heartbeat = std::chrono::steady_clock::now() - last_heard_time >=
+                         heartbeat_interval;
+  if (awaiting_response && idle_state == IS_IDLE &&
+      (heartbeat || has_pending_work())) {
+    // Interrupt "idle" to send queued commands, or to check that MPD is
+    // still there. MPD replies to "idle" with its (possibly empty) list of
+    // changes.
+    ssize_t write_ret;
+    if (uring.is_open()) {
+      // Nothing else is being sent, "idle" went out already. The result is
+      // picked up by "write_read()" before that of the next request.
+      write_ret = uring.start_send(NOIDLE_CMD)
+                      ? static_cast<ssize_t>(NOIDLE_CMD.size())
+                      : -1;
+      uring_sending_noidle = write_ret > 0;
+    } else {
+      write_ret = send(conn_socket, NOIDLE_CMD.data(), NOIDLE_CMD.size(),
+                       MSG_NOSIGNAL);
+    }
+    if (write_ret == static_cast<ssize_t>(NOIDLE_CMD.size())) {
+      trace_sent(NOIDLE_CMD);
+      if (heartbeat) {
+        LOG_PRINT(level, LogLevel::VERBOSE,
+                  "VERBOSE: Checking the idle connection to MPD.");
+      }
+      idle_state = IS_NOIDLE;
+      io_deadline = std::chrono::steady_clock::now() + MPD_CLI_READ_TIMEOUT;
+    } else if (write_ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // Try again on next update.
+    } else {
+      cleanup_close_conn();
+      set_conn_state(CS_FAILED);
+      idle_state = IS_NONE;
+      LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to write \"noidle\"!");
+      return false;
+    }
+  }
+
+  auto [status, str] = write_read("idle player options database\n");
+  if (!is_ok() ||
+      (status != StatusEnum::SE_SUCCESS && !is_status_eagain(status))) {
+    cleanup_close_conn();
+    set_conn_state(CS_FAILED);
+    idle_state = IS_NONE;
+    LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to \"idle\" MPD!");
+    return false;
+  } else if (is_status_eagain(status)) {
+    return false;
+  }
+
+  idle_state = IS_NONE;
+  if (str.starts_with("ACK ")) {
+    LOG_PRINT(level, LogLevel::WARNING, "WARNING: \"idle\" failed: {}", str);
+    // Fall back to fetching everything again.
+    request_data_update();
+  }
+
+  return true;
+}
+
+void MPDClient::parse_for_song_info(const ResponseParser::Event &event) {
+  if (!is_ok() || event.type != ResponseParser::EV_KEY_VALUE) {
+    return;
+  }
+
+  const std::string_view &value = event.value;
+  switch (song_info_key(event.key)) {
+    case SK_TITLE:
+      song_title.assign(value);
+      break;
+    case SK_ARTIST:
+      song_artist.assign(value);
+      break;
+    case SK_ALBUM:
+      song_album.assign(value);
+      break;
+    case SK_FILE:
+      if (value != song_filename) {
+        // New song. "status" and "currentsong" are fetched together in one
+        // command list, so the rest of the info is already up to date.
+        if (next_album_art_fetched && value == next_song_filename) {
+          // Its album art was prefetched while the previous song played.
+          album_art_needed = false;
+          album_art_failed = !next_album_art;
+          fetched_album_art = std::move(next_album_art);
+          fetched_album_art_mime_type = std::move(next_album_art_mime_type);
+          next_album_art.reset();
+          next_album_art_mime_type.clear();
+        } else {
+          start_album_art_fetch();
+        }
+        song_filename.assign(value);
+      }
+      break;
+    case SK_DURATION:
+      if (std::optional<double> duration = parse_double(value)) {
+        song_duration = *duration;
+      } else {
+        LOG_PRINT(level, LogLevel::WARNING,
+                  "WARNING: Failed to parse song duration! {}", value);
+      }
+      break;
+    case SK_ELAPSED:
+      elapsed_time_point = std::chrono::steady_clock::now();
+      if (std::optional<double> elapsed = parse_double(value)) {
+        elapsed_time = *elapsed;
+      } else {
+        LOG_PRINT(level, LogLevel::WARNING,
+                  "WARNING: Failed to parse song elapsed! {}", value);
+      }
+      break;
+    case SK_STATE:
+      mpd_play_state.assign(value);
+      break;
+    case SK_SONG_ID:
+      status_song_id.assign(value);
+      break;
+    case SK_PLAYLIST:
+      status_playlist_version.assign(value);
+      break;
+    case SK_NEXT_SONG_ID:
+      status_next_song_id.assign(value);
+      break;
+    case SK_NONE:
+      break;
+  }
+}
+
+void MPDClient::parse_for_next_song_info(const ResponseParser::Event &event) {
+  if (!is_ok() || event.type != ResponseParser::EV_KEY_VALUE) {
+    return;
+  }
+
+  switch (song_info_key(event.key)) {
+    case SK_TITLE:
+      next_song_title.assign(event.value);
+      break;
+    case SK_ARTIST:
+      next_song_artist.assign(event.value);
+      break;
+    case SK_ALBUM:
+      next_song_album.assign(event.value);
+      break;
+    case SK_FILE:
+      next_song_filename.assign(event.value);
+      break;
+    default:
+      break;
+  }
+}
+
+void MPDClient::parse_for_idle_changes(const ResponseParser::Event &event) {
+  if (event.type == ResponseParser::EV_KEY_VALUE && event.key == "changed") {
+    LOG_PRINT(level, LogLevel::VERBOSE, "VERBOSE: idle changed: {}",
+              event.value);
+    if (event.value == "player" || event.value == "options") {
+      request_data_update();
+    } else if (event.value == "database") {
+      // Pictures may have been added or removed.
+      art_cache->clear();
+    }
+  }
+}
+
+void MPDClient::parse_for_album_art(const ResponseParser::Event &event) {
+  if (!is_ok() || !album_art_offset.has_value() ||
+      (!album_art_needed && !album_art_for_next_song)) {
+    pending_response = PR_NONE;
+    return;
+  }
+
+  if (event.type == ResponseParser::EV_BINARY) {
+    if (pending_response == PR_ALBUM_ART_PAYLOAD) {
+      // Payload bytes that arrived together with the chunk header.
+      std::memcpy(album_art->data() + album_art_offset.value(),
+                  event.value.data(), event.value.size());
+      album_art_offset.value() += event.value.size();
+    }
+    return;
+  } else if (event.type == ResponseParser::EV_LIST_OK) {
+    // The header of the next requested chunk follows.
+    album_art_request_offset += album_art_chunk_size;
+    pending_response = PR_ALBUM_ART_HEADER;
+    return;
+  } else if (event.type != ResponseParser::EV_KEY_VALUE ||
+             pending_response != PR_ALBUM_ART_HEADER) {
+    return;
+  }
+
+  if (event.key == "size") {
+    size_t size = 0;
+    if (std::from_chars(event.value.data(),
+                        event.value.data() + event.value.size(), size)
+            .ec != std::errc{}) {
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Failed to parse albumart size!");
+      discard_album_art();
+    } else if (album_art_expected_size == 0) {
+      album_art_expected_size = size;
+    } else if (size != album_art_expected_size) {
+      // The picture changed since the fetch was resumed, start over. The
+      // offset no longer matches the request, so this payload is skipped.
+      LOG_PRINT(level, LogLevel::WARNING,
+                "WARNING: Album art size changed, fetching it again.");
+      discard_album_art();
+      album_art_expected_size = size;
+    }
+  } else if (event.key == "type") {
+    if (album_art_mime_type.empty()) {
+      album_art_mime_type.assign(event.value);
+    }
+  } else if (event.key == "binary") {
+    // From here on the payload is not wanted, unless the header is valid. An
+    // invalid header means no album art from this command.
+    pending_response = PR_NONE;
+
+    size_t chunk_size = 0;
+    if (album_art_expected_size == 0) {
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Failed to parse albumart size!");
+      discard_album_art();
+      return;
+    } else if (album_art_mime_type.empty()) {
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Failed to parse albumart mime-type!");
+      discard_album_art();
+      return;
+    } else if (std::from_chars(event.value.data(),
+                               event.value.data() + event.value.size(),
+                               chunk_size)
+                   .ec != std::errc{}) {
+      LOG_PRINT(level, LogLevel::ERROR,
+                "ERROR: Failed to parse albumart chunk size!");
+      discard_album_art();
+      return;
+    } else if (chunk_size == 0) {
+      LOG_PRINT(
+          level, LogLevel::ERROR,
+          "ERROR: Failed to parse albumart chunk size! (chunk_size is zero)");
+      discard_album_art();
+      return;
+    } else if (album_art_offset.value() != album_art_request_offset) {
+      // An earlier chunk in the same command list was shorter than the
+      // stride, so this one doesn't follow it. It is requested again.
+      return;
+    } else if (album_art_offset.value() + chunk_size >
+               album_art_expected_size) {
+      LOG_PRINT(level, LogLevel::ERROR, "ERROR: Invalid album_art size!");
+      discard_album_art();
+      return;
+    }
+
+    album_art_chunk_size = std::max(album_art_chunk_size, chunk_size);
+    ++request_chunks;
+
+    if (!album_art) {
+      // Sized up front so that every chunk can be read into place.
+      album_art = std::make_shared<std::vector<char> >(album_art_expected_size);
+    }
+    pending_response = PR_ALBUM_ART_PAYLOAD;
+  }
+}
+
+void MPDClient::discard_album_art() {
+  album_art.reset();
+  album_art_offset = 0;
+  album_art_expected_size = 0;
+  album_art_chunk_size = 0;
+  album_art_mime_type.clear();
 }
@@ -17,21 +17,46 @@
 #ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_MPD_CLIENT_H_
 #define SEODISPARATE_COM_MPD_INFO_SCREEN_2_MPD_CLIENT_H_
 
-#include <bitset>
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
+// Unix includes
+#include <poll.h>
+
 // local includes
+#include "album_art_cache.h"
 #include "constants.h"
+#include "host_resolver.h"
+#include "io_uring_socket.h"
+#include "protocol_trace.h"
+#include "response_parser.h"
+#include "ring_buffer.h"
+
+/// Album art that was partly fetched when its connection was lost, so that
+/// the fetch can resume where it stopped.
+struct PartialAlbumArt {
+  std::string filename;
+  std::shared_ptr<std::vector<char> > data;
+  size_t offset = 0;
+  size_t expected_size = 0;
+  std::string mime_type;
+  // fetched with "albumart" instead of "readpicture"
+  bool from_albumart = false;
+};
 
 class MPDClient {
  public:
-  MPDClient(std::string host, uint16_t host_port, LogLevel level,
-            bool is_socket);
+  MPDClient(
+      std::string host, uint16_t host_port, LogLevel level, bool is_socket,
+      std::chrono::milliseconds connect_timeout = MPD_CLI_CONNECT_TIMEOUT,
+      std::chrono::milliseconds heartbeat_interval =
+          MPD_CLI_HEARTBEAT_INTERVAL);
   ~MPDClient();
 
   // No copy
@@ -43,12 +68,40 @@ class MPDClient {
   MPDClient &operator=(MPDClient &&);
 
   void reset_connection();
+  /// Takes the album art that is partly fetched, to hand to the client that
+  /// replaces this one.
+  PartialAlbumArt take_partial_album_art();
+  /// The next fetch of "partial.filename"'s album art resumes from
+  /// "partial".
+  void set_partial_album_art(PartialAlbumArt partial);
+  /// Records the bytes sent and received on every following connection,
+  /// including the album art connection's, to "trace".
+  void set_trace(std::shared_ptr<ProtocolTrace> trace);
+  const std::shared_ptr<ProtocolTrace> &get_trace() const;
+  /// Whether the following connections, including the album art
+  /// connection's, send and receive through io_uring. On by default, but
+  /// only takes effect if built with USE_IO_URING and the kernel allows
+  /// it.
+  void set_io_uring(bool enabled);
+  /// True if the current connection goes through io_uring.
+  bool is_using_io_uring() const;
   bool is_ok() const;
+  /// True while the non-blocking connect to MPD has not finished yet.
+  bool is_connecting() const;
 
   bool needs_auth() const;
-  bool attempt_auth(std::string passwd);
+  /// Queues a "password" command, sent on a following "update()".
+  void attempt_auth(std::string passwd);
+  /// True until the reply to the password given to "attempt_auth()" arrives.
+  bool is_authenticating() const;
+  /// True if MPD rejected the last password.
+  bool auth_failed() const;
 
   void update();
+  /// Blocks until the connection is ready for the request in flight,
+  /// "wake_fd" is readable, or "timeout_ms" passes. Returns right away if
+  /// there is more to do without waiting.
+  void wait_for_io(int wake_fd, int timeout_ms) const;
 
   const std::string &get_song_title() const;
   const std::string &get_song_artist() const;
@@ -57,33 +110,150 @@ class MPDClient {
   double get_song_duration() const;
   std::tuple<double, std::chrono::steady_clock::time_point> get_elapsed_time()
       const;
-  const std::optional<std::vector<char> > &get_album_art() const;
+  /// Returns nullptr until the album art is fully fetched. The returned data
+  /// is never modified afterwards, so it may be shared with other threads.
+  std::shared_ptr<const std::vector<char> > get_album_art() const;
   const std::string &get_album_art_mime_type() const;
 
+  // The song queued after the current one, fetched ahead of time.
+  const std::string &get_next_song_title() const;
+  const std::string &get_next_song_artist() const;
+  const std::string &get_next_song_album() const;
+  const std::string &get_next_song_filename() const;
+  /// Returns nullptr until the next song's album art is fully fetched. Once
+  /// that song starts playing, "get_album_art()" returns the same data.
+  std::shared_ptr<const std::vector<char> > get_next_album_art() const;
+  const std::string &get_next_album_art_mime_type() const;
+
   const std::string &get_play_state() const;
 
   bool song_has_album_art() const;
 
+  /// Fetches "status" again, and "currentsong" too if the song changed.
   void request_data_update();
   void request_refetch_album_art();
 
   bool ping_success() const;
 
+  /// True until the album art of the file last given to "fetch_album_art()"
+  /// is fetched (or found to not exist). Only used on the album art
+  /// connection.
+  bool is_fetching_album_art() const;
+
+  /// The "binarylimit" in use, adjusted to the measured throughput.
+  size_t get_binary_limit() const;
+  /// Returns the "binarylimit" that keeps a chunk near
+  /// MPD_CLI_ART_CHUNK_TARGET, within MPD_BINARY_LIMIT_MIN and
+  /// MPD_BINARY_LIMIT.
+  static size_t choose_binary_limit(double bytes_per_second,
+                                    std::chrono::microseconds round_trip_time);
+
  private:
   enum StatusEnum {
     SE_SUCCESS,
     SE_EAGAIN_ON_READ,
+    SE_EAGAIN_ON_WRITE,
     SE_GENERIC_ERROR,
     SE_READ_TIMED_OUT,
     SE_WRITE_TIMED_OUT
   };
 
+  /// Requests picked by "next_command()". A queued password comes first,
+  /// then connection setup, then the song info, then album art of the
+  /// current song (background work), then fetching the next song ahead of
+  /// time.
+  enum Command {
+    CMD_NONE,
+    CMD_PASSWORD,
+    CMD_BINARYLIMIT,
+    CMD_PING,
+    CMD_STATUS,
+    CMD_ALBUM_ART,
+    CMD_NEXT_SONG,
+    CMD_NEXT_ALBUM_ART
+  };
+
+  /// What "send_status()" asks for. "status" alone is enough to tell if the
+  /// song info is still current.
+  enum SongInfoRequest {
+    // "status" and "currentsong" in one command list
+    SIR_FULL,
+    // "status" alone
+    SIR_STATUS,
+    // "currentsong" alone, after "status" alone reported a new song
+    SIR_CURRENT_SONG
+  };
+
+  /// Where the connection to MPD is. Each "update_step()" acts on the state
+  /// it is in, and moves it along once that step is done.
+  enum ConnState {
+    // failed, stays so until "reset_connection()"
+    CS_FAILED,
+    // connects on the next "update()"
+    CS_INIT,
+    // host name lookup in progress
+    CS_RESOLVING,
+    // non-blocking connect in progress
+    CS_CONNECTING,
+    // waiting on the initial "OK MPD <version>"
+    CS_GREETING,
+    // connected, requests are sent
+    CS_READY
+  };
+
+  /// Where "idle" is at. While not "IS_NONE", the response awaited is the
+  /// list of changes "idle" replies with.
+  enum IdleState {
+    // not idling
+    IS_NONE,
+    // "idle" queued or sent, waiting on MPD to report a change
+    IS_IDLE,
+    // "noidle" sent to end "idle" early
+    IS_NOIDLE
+  };
+
+  /// What the response in flight is parsed for, see
+  /// "handle_response_event()".
+  enum PendingResponse {
+    // nothing, or the rest of the response is not wanted
+    PR_NONE,
+    // "status"/"currentsong" command list
+    PR_SONG_INFO,
+    // "playlistid" of the next song
+    PR_NEXT_SONG_INFO,
+    // album art chunk header, its payload goes into "album_art"
+    PR_ALBUM_ART_HEADER,
+    // album art chunk payload, after its header
+    PR_ALBUM_ART_PAYLOAD
+  };
+
+  constexpr static std::string conn_state_to_str(ConnState val) {
+    switch (val) {
+      case CS_FAILED:
+        return "CS_FAILED";
+      case CS_INIT:
+        return "CS_INIT";
+      case CS_RESOLVING:
+        return "CS_RESOLVING";
+      case CS_CONNECTING:
+        return "CS_CONNECTING";
+      case CS_GREETING:
+        return "CS_GREETING";
+      case CS_READY:
+        return "CS_READY";
+      default:
+        return "UNKNOWN";
+    }
+  }
+
   constexpr static std::string status_to_str(StatusEnum val) {
     switch (val) {
       case SE_SUCCESS:
         return "SE_SUCCESS";
       case SE_EAGAIN_ON_READ:
         return "SE_EAGAIN_ON_READ";
+      case SE_EAGAIN_ON_WRITE:
+        return "SE_EAGAIN_ON_WRITE";
       case SE_GENERIC_ERROR:
         return "SE_GENERIC_ERROR";
       case SE_READ_TIMED_OUT:
@@ -95,24 +265,61 @@ class MPDClient {
     }
   }
 
-  // 0 - invalid state
-  // 1 - initial state
-  // 2 - successful ping
-  // 3 - successful status
-  // 4 - waiting on read
-  // 5 - permission/auth required
-  // 6 - successful "currentsong"
-  // 7 - non-blocking set
-  // 8 - need to fetch album art
-  // 9 - current song no "readpicture"
-  // 10 - current song no "albumart"
-  // 11 - failed to fetch album art
-  // 12 - is using unix socket
-  std::bitset<64> flags;
+  // "ping", "status" and "currentsong" succeeded on this connection
+  bool ping_ok;
+  // cleared to fetch "status" again
+  bool status_ok;
+  bool current_song_ok;
+  // "binarylimit" succeeded (cleared to send a new one)
+  bool binary_limit_set;
+  // MPD wants a password before anything else
+  bool auth_required;
+  // "password" queued or sent
+  bool auth_pending;
+  // the last password was rejected
+  bool auth_rejected;
+  bool is_unix_socket;
+  // the album art connection, only fetches album art
+  bool is_art_client;
+  ConnState conn_state;
+  IdleState idle_state;
+  // request sent, waiting on its response
+  bool awaiting_response;
+  PendingResponse pending_response;
+  // album art of the current song must be fetched
+  bool album_art_needed;
+  // the current song has no "readpicture"/"albumart"
+  bool no_readpicture;
+  bool no_albumart;
+  // the current song's album art failed to fetch, or it has none
+  bool album_art_failed;
+  // the album art being fetched is for the next song
+  bool album_art_for_next_song;
+  // the next song's info was fetched
+  bool next_song_fetched;
+  // the next song's album art was fetched (or it has none)
+  bool next_album_art_fetched;
+  // album art connection failed, album art is fetched on this connection
+  bool album_art_on_main;
+  // album art must be fetched again, even if "art_client" has it
+  bool album_art_refetch;
   LogLevel level;
-  std::optional<uint32_t> host_ip_value;
+  std::string host_name;
   uint16_t host_port;
   int conn_socket;
+  // "conn_socket" is sent on and received from through this if it is open
+  IoUringSocket uring;
+  bool use_io_uring;
+  // "noidle" is in flight on "uring", its result isn't "write_buf"'s
+  bool uring_sending_noidle;
+  HostResolver resolver;
+  // addresses to race connects to, tried in order
+  std::vector<SockAddr> connect_addrs;
+  size_t connect_addrs_idx;
+  // connects in progress, the first to finish becomes "conn_socket"
+  std::vector<int> connect_sockets;
+  std::chrono::steady_clock::time_point connect_attempt_time;
+  int connect_errno;
 
   std::string socket_path;
   // current song info
@@ -124,18 +331,175 @@ class MPDClient {
   std::chrono::steady_clock::time_point elapsed_time_point;
   double elapsed_time;
   double song_duration;
-  std::optional<std::vector<char> > album_art;
-  std::optional<std::vector<char> > dummy_album_art_ref;
+  // album art of the current song, once fully fetched
+  std::shared_ptr<const std::vector<char> > fetched_album_art;
+  std::string fetched_album_art_mime_type;
+  // "songid" and "playlist" (queue version) of the last "status", to tell if
+  // "currentsong" needs to be fetched
+  std::string song_id;
+  std::string status_song_id;
+  std::string playlist_version;
+  std::string status_playlist_version;
+  // next song info
+  std::string next_song_id;
+  std::string status_next_song_id;
+  std::string next_song_title;
+  std::string next_song_artist;
+  std::string next_song_album;
+  std::string next_song_filename;
+  std::shared_ptr<const std::vector<char> > next_album_art;
+  std::string next_album_art_mime_type;
+  // album art being fetched, for the current or the next song (see
+  // "album_art_for_next_song")
+  std::shared_ptr<std::vector<char> > album_art;
   std::string album_art_mime_type;
   std::optional<size_t> album_art_offset;
   size_t album_art_expected_size;
+  // largest chunk MPD has sent, chunks after the first are requested in a
+  // command list with this stride
+  size_t album_art_chunk_size;
+  // offset the chunk currently being received was requested at
+  size_t album_art_request_offset;
+  // pending request
+  std::string write_buf;
+  RingBuffer recv_buf;
+  // size of the last response returned by "write_read()"
+  size_t response_size;
+  ResponseParser parser;
+  std::chrono::steady_clock::time_point io_deadline;
+  // when data from MPD last arrived
+  std::chrono::steady_clock::time_point last_heard_time;
+  std::chrono::milliseconds connect_timeout;
+  std::chrono::milliseconds heartbeat_interval;
+  // request in flight, or the last one
+  Command current_command;
+  // what the last "CMD_STATUS" asked for
+  SongInfoRequest song_info_request;
+  // when "status"/"currentsong" last succeeded
+  std::chrono::steady_clock::time_point status_time;
+  // measured on the current connection; the round trip time is that of
+  // album art requests, including MPD's time to read the picture
+  size_t binary_limit;
+  std::chrono::microseconds round_trip_time;
+  double bytes_per_second;
+  // when the request in flight was sent, how long until its first byte
+  // arrived, and how much was read for it
+  std::chrono::steady_clock::time_point request_time;
+  std::chrono::microseconds request_latency;
+  size_t request_bytes;
+  size_t request_chunks;
+  // Second connection for album art, opened when album art is first needed,
+  // so that large transfers don't hold up the requests on this connection.
+  std::unique_ptr<MPDClient> art_client;
+  std::chrono::steady_clock::time_point art_client_retry_time;
+  // sent again on "art_client" if it needs auth too
+  std::string password;
+  // given to "attempt_auth()", not sent or not replied to yet
+  std::string auth_password;
+  // file the album art in "album_art"/"fetched_album_art" is for, only used
+  // on the album art connection
+  std::string album_art_filename;
+  // kept from a lost connection
+  PartialAlbumArt partial_album_art;
+  // shared with "art_client"
+  std::shared_ptr<AlbumArtCache> art_cache;
+  // shared with "art_client", nullptr unless recording
+  std::shared_ptr<ProtocolTrace> trace;
+  uint32_t trace_connection;
+
+  static bool is_status_eagain(StatusEnum status);
+
+  /// Returns true if another step can be taken without waiting.
+  bool update_step();
+  /// Logs the change and moves to "state".
+  void set_conn_state(ConnState state);
+  /// CS_INIT: opens the unix socket path, or starts resolving the host.
+  bool start_connection();
+  /// CS_RESOLVING: starts connecting once the host name is resolved.
+  bool update_resolving();
+  /// CS_GREETING: reads MPD's "OK MPD <version>".
+  bool read_greeting();
+  /// Continues the request in flight, or sends the one "next_command()"
+  /// picks. A lower priority request waits for the one in flight to finish,
+  /// but never goes before a higher priority one.
+  bool run_next_command();
+  Command next_command() const;
+  bool send_password();
+  bool send_binarylimit();
+  bool send_ping();
+  bool send_status();
+  bool send_next_song();
 
-  std::tuple<StatusEnum, std::string> write_read(std::string to_send);
+  /// Never blocks. Returns SE_EAGAIN_ON_WRITE/SE_EAGAIN_ON_READ if the
+  /// response isn't available yet; call again (with the same "to_send") on a
+  /// later update to continue. The response is parsed as it arrives (see
+  /// "handle_response_event()"); only its last line ("OK..." or "ACK ...") is
+  /// returned, pointing into "recv_buf" and valid until the next call.
+  std::tuple<StatusEnum, std::string_view> write_read(
+      std::string_view to_send);
+  /// Reads from "conn_socket" like "RingBuffer::read_from()" into
+  /// "recv_buf", or takes what "uring" received if it is open.
+  ssize_t receive(char *front, size_t front_size, size_t max_size);
+  /// Passes a response event to the parser for the request in flight.
+  void handle_response_event(const ResponseParser::Event &event);
+  /// Updates the round trip time and throughput from the album art request
+  /// that just finished, and asks for a new "binarylimit" if it is off.
+  void measure_request();
 
+  /// Starts a non-blocking connect to "addr" and adds it to
+  /// "connect_sockets".
+  void start_connect_attempt(const SockAddr &addr);
+  /// Starts connects to "connect_addrs" a short delay apart (Happy Eyeballs,
+  /// RFC 8305). Returns true once one succeeds and is now "conn_socket".
+  bool check_connect();
+  /// Sets TCP keepalive and TCP_NODELAY on "conn_socket".
+  void set_tcp_options();
+  /// Logs how long after MPD was last heard from the connection was found
+  /// to be lost.
+  void log_connection_lost() const;
+  void trace_sent(std::string_view data);
+  /// Records one read that put "front" in place elsewhere, and the last
+  /// "buffered" bytes in "recv_buf".
+  void trace_received(std::string_view front, size_t buffered);
   void cleanup_close_conn();
 
-  void parse_for_song_info(const std::string &buf);
-  void parse_for_album_art(const std::string &buf);
+  bool has_pending_work() const;
+  void enter_idle();
+  /// Returns true if no longer idling (commands can be sent).
+  bool update_idle();
+
+  /// Sends the next "readpicture"/"albumart" request for "filename". Returns
+  /// true if another step can be taken without waiting.
+  bool update_album_art(const std::string &filename);
+  /// Stores the album art that was being fetched, for the current or the
+  /// next song.
+  void finish_album_art(bool fetched);
+  /// Forgets the next song, it changed.
+  void reset_next_song();
+
+  /// Hands album art to fetch to "art_client", and takes what it fetched.
+  void update_art_client();
+  /// Starts fetching the album art of "filename" on the album art
+  /// connection, dropping what was fetched before.
+  void fetch_album_art(const std::string &filename);
+  /// Adds the descriptors to wait on to "pfds" and lowers "timeout_ms" to
+  /// when an update is due. Returns false if an update can be done without
+  /// waiting.
+  bool add_poll_fds(struct pollfd *pfds, nfds_t &count, int &timeout_ms) const;
+
+  void parse_for_song_info(const ResponseParser::Event &event);
+  void parse_for_next_song_info(const ResponseParser::Event &event);
+  void parse_for_idle_changes(const ResponseParser::Event &event);
+  /// Parses an album art chunk header, and copies payload bytes that arrived
+  /// with it into "album_art". The rest of the payload is read directly into
+  /// "album_art" by "write_read()".
+  void parse_for_album_art(const ResponseParser::Event &event);
+  void discard_album_art();
+  /// Fetches the current song's album art again.
+  void start_album_art_fetch();
+  /// Keeps the album art being fetched in "partial_album_art", if some but
+  /// not all of it was fetched.
+  void save_partial_album_art();
 };
 
 #endif
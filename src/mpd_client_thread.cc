@@ -0,0 +1,181 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "mpd_client_thread.h"
+
+// Unix includes
+#include <fcntl.h>
+#include <unistd.h>
+
+MPDClientThread::MPDClientThread(MPDClient cli, std::string host,
+                                 uint16_t host_port, LogLevel level,
+                                 bool is_socket,
+                                 std::chrono::milliseconds connect_timeout,
+                                 std::chrono::milliseconds heartbeat_interval)
+    : snapshots(),
+      cli(std::move(cli)),
+      host(std::move(host)),
+      host_port(host_port),
+      level(level),
+      is_socket(is_socket),
+      connect_timeout(connect_timeout),
+      heartbeat_interval(heartbeat_interval),
+      generation(0),
+      auth_attempts(0),
+      auth_failed(false),
+      auth_pending(false),
+      passwd_mutex(),
+      passwd(),
+      requested_generation(0),
+      refetch_requested(false),
+      stop_requested(false),
+      wake_pipe{-1, -1},
+      thread() {
+  if (pipe(wake_pipe) != 0) {
+    LOG_PRINT(level, LogLevel::ERROR,
+              "ERROR: Failed to create wake pipe! errno {}", errno);
+    wake_pipe[0] = -1;
+    wake_pipe[1] = -1;
+  } else {
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+  }
+
+  publish();
+  thread = std::thread(&MPDClientThread::run, this);
+}
+
+MPDClientThread::~MPDClientThread() {
+  stop_requested.store(true);
+  wake();
+  if (thread.joinable()) {
+    thread.join();
+  }
+  if (wake_pipe[0] >= 0) {
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+  }
+}
+
+void MPDClientThread::fetch_snapshot() { snapshots.fetch(); }
+
+const MPDSnapshot &MPDClientThread::get_snapshot() const {
+  return snapshots.get_front();
+}
+
+uint64_t MPDClientThread::reconnect() {
+  uint64_t new_generation = requested_generation.fetch_add(1) + 1;
+  wake();
+  return new_generation;
+}
+
+void MPDClientThread::attempt_auth(std::string passwd) {
+  {
+    std::lock_guard<std::mutex> lock(passwd_mutex);
+    this->passwd = std::move(passwd);
+  }
+  wake();
+}
+
+void MPDClientThread::request_refetch_album_art() {
+  refetch_requested.store(true);
+  wake();
+}
+
+void MPDClientThread::run() {
+  while (!stop_requested.load()) {
+    handle_requests();
+    cli.update();
+    if (auth_pending && !cli.is_authenticating()) {
+      auth_pending = false;
+      auth_failed = cli.auth_failed();
+      ++auth_attempts;
+    }
+    publish();
+
+    cli.wait_for_io(wake_pipe[0],
+                    static_cast<int>(MPD_THREAD_WAIT_TIMEOUT.count()));
+    if (wake_pipe[0] >= 0) {
+      char buf[64];
+      while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+  }
+}
+
+void MPDClientThread::handle_requests() {
+  uint64_t new_generation = requested_generation.load();
+  if (new_generation != generation) {
+    generation = new_generation;
+    // What was fetched of the album art is continued on the new connection.
+    PartialAlbumArt partial = cli.take_partial_album_art();
+    std::shared_ptr<ProtocolTrace> trace = cli.get_trace();
+    cli = MPDClient(host, host_port, level, is_socket, connect_timeout,
+                    heartbeat_interval);
+    cli.set_partial_album_art(std::move(partial));
+    cli.set_trace(std::move(trace));
+  }
+
+  std::optional<std::string> new_passwd;
+  {
+    std::lock_guard<std::mutex> lock(passwd_mutex);
+    new_passwd.swap(passwd);
+  }
+  if (new_passwd.has_value()) {
+    // The result is known after a following "cli.update()".
+    cli.attempt_auth(std::move(new_passwd.value()));
+    auth_pending = true;
+  }
+
+  if (refetch_requested.exchange(false)) {
+    cli.request_refetch_album_art();
+  }
+}
+
+void MPDClientThread::publish() {
+  MPDSnapshot &snapshot = snapshots.get_back();
+  snapshot.song_title.assign(cli.get_song_title());
+  snapshot.song_artist.assign(cli.get_song_artist());
+  snapshot.song_album.assign(cli.get_song_album());
+  snapshot.song_filename.assign(cli.get_song_filename());
+  snapshot.play_state.assign(cli.get_play_state());
+  snapshot.album_art_mime_type.assign(cli.get_album_art_mime_type());
+  snapshot.album_art = cli.get_album_art();
+  snapshot.next_song_title.assign(cli.get_next_song_title());
+  snapshot.next_song_artist.assign(cli.get_next_song_artist());
+  snapshot.next_song_album.assign(cli.get_next_song_album());
+  snapshot.next_song_filename.assign(cli.get_next_song_filename());
+  snapshot.next_album_art_mime_type.assign(cli.get_next_album_art_mime_type());
+  snapshot.next_album_art = cli.get_next_album_art();
+  std::tie(snapshot.elapsed_time, snapshot.elapsed_time_point) =
+      cli.get_elapsed_time();
+  snapshot.song_duration = cli.get_song_duration();
+  snapshot.generation = generation;
+  snapshot.auth_attempts = auth_attempts;
+  snapshot.is_ok = cli.is_ok();
+  snapshot.is_connecting = cli.is_connecting();
+  snapshot.ping_success = cli.ping_success();
+  snapshot.needs_auth = cli.needs_auth();
+  snapshot.auth_failed = auth_failed;
+  snapshots.publish();
+}
+
+void MPDClientThread::wake() {
+  if (wake_pipe[1] >= 0) {
+    char c = 0;
+    [[maybe_unused]] ssize_t ret = write(wake_pipe[1], &c, 1);
+  }
+}
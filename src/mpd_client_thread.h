@@ -0,0 +1,127 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_MPD_CLIENT_THREAD_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_MPD_CLIENT_THREAD_H_
+
+// standard library includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "constants.h"
+#include "mpd_client.h"
+#include "triple_buffer.h"
+
+/// Everything the renderer needs from MPDClient, copied out after each update.
+struct MPDSnapshot {
+  std::string song_title;
+  std::string song_artist;
+  std::string song_album;
+  std::string song_filename;
+  std::string play_state;
+  std::string album_art_mime_type;
+  // nullptr until fetched
+  std::shared_ptr<const std::vector<char> > album_art;
+  // the song queued after the current one, fetched ahead of time
+  std::string next_song_title;
+  std::string next_song_artist;
+  std::string next_song_album;
+  std::string next_song_filename;
+  std::string next_album_art_mime_type;
+  // nullptr until fetched, becomes "album_art" once the song plays
+  std::shared_ptr<const std::vector<char> > next_album_art;
+  std::chrono::steady_clock::time_point elapsed_time_point;
+  double elapsed_time = 0.0;
+  double song_duration = 0.0;
+  // incremented on every "MPDClientThread::reconnect()"
+  uint64_t generation = 0;
+  // incremented after every "MPDClientThread::attempt_auth()"
+  uint64_t auth_attempts = 0;
+  bool is_ok = false;
+  bool is_connecting = false;
+  bool ping_success = false;
+  bool needs_auth = false;
+  bool auth_failed = false;
+};
+
+/// Runs an MPDClient on its own thread, so socket I/O never stalls drawing.
+/// The render thread only reads snapshots and posts requests.
+class MPDClientThread {
+ public:
+  MPDClientThread(MPDClient cli, std::string host, uint16_t host_port,
+                  LogLevel level, bool is_socket,
+                  std::chrono::milliseconds connect_timeout,
+                  std::chrono::milliseconds heartbeat_interval);
+  ~MPDClientThread();
+
+  // No copy/move, the network thread refers to this object.
+  MPDClientThread(const MPDClientThread &) = delete;
+  MPDClientThread &operator=(const MPDClientThread &) = delete;
+
+  /// Render thread only. Makes the latest published snapshot current.
+  void fetch_snapshot();
+  /// Render thread only.
+  const MPDSnapshot &get_snapshot() const;
+
+  // Requests, handled on the network thread.
+
+  /// Replaces the client with a new connection. Returns the generation that
+  /// snapshots of the new client will have.
+  uint64_t reconnect();
+  /// The result is published as "auth_attempts"/"auth_failed".
+  void attempt_auth(std::string passwd);
+  void request_refetch_album_art();
+
+ private:
+  void run();
+  void handle_requests();
+  void publish();
+  void wake();
+
+  TripleBuffer<MPDSnapshot> snapshots;
+  // only used on the network thread
+  MPDClient cli;
+  std::string host;
+  uint16_t host_port;
+  LogLevel level;
+  bool is_socket;
+  std::chrono::milliseconds connect_timeout;
+  std::chrono::milliseconds heartbeat_interval;
+  uint64_t generation;
+  uint64_t auth_attempts;
+  bool auth_failed;
+  // "cli" has not replied to the last password yet
+  bool auth_pending;
+
+  std::mutex passwd_mutex;
+  std::optional<std::string> passwd;
+  std::atomic_uint64_t requested_generation;
+  std::atomic_bool refetch_requested;
+  std::atomic_bool stop_requested;
+  // written to wake the network thread
+  int wake_pipe[2];
+  std::thread thread;
+};
+
+#endif
@@ -20,7 +20,7 @@
 #include "args.h"
 #include "constants.h"
 #include "helpers.h"
-#include "mpd_client.h"
+#include "mpd_client_thread.h"
 
 // standard library includes
 #include <chrono>
@@ -101,6 +101,10 @@ MPDDisplay::MPDDisplay(const std::bitset<64> &args_flags, LogLevel level)
     : level(level),
       flags(),
       texture(),
+      texture_art(),
+      attempted_art(),
+      next_texture(),
+      next_texture_art(),
       refresh_timepoint(std::chrono::steady_clock::now()),
       remaining_x(0),
       remaining_y(0),
@@ -122,6 +126,10 @@ MPDDisplay::~MPDDisplay() {
     UnloadTexture(*texture);
   }
 
+  if (next_texture) {
+    UnloadTexture(*next_texture);
+  }
+
   if (default_font) {
     UnloadFont(*default_font);
   }
@@ -131,6 +139,10 @@ MPDDisplay::MPDDisplay(MPDDisplay &&other)
     : level(other.level),
       flags(std::move(other.flags)),
       texture(std::move(other.texture)),
+      texture_art(std::move(other.texture_art)),
+      attempted_art(std::move(other.attempted_art)),
+      next_texture(std::move(other.next_texture)),
+      next_texture_art(std::move(other.next_texture_art)),
       refresh_timepoint(std::move(other.refresh_timepoint)),
       remaining_x(0),
       remaining_y(0),
@@ -147,13 +159,18 @@ MPDDisplay &MPDDisplay::operator=(MPDDisplay &&other) {
   level = other.level;
   flags = std::move(other.flags);
   texture = std::move(other.texture);
+  texture_art = std::move(other.texture_art);
+  attempted_art = std::move(other.attempted_art);
+  next_texture = std::move(other.next_texture);
+  next_texture_art = std::move(other.next_texture_art);
   refresh_timepoint = std::move(other.refresh_timepoint);
 
   return *this;
 }
 
-void MPDDisplay::update(MPDClient &cli, const Args &args) {
-  if (!cli.is_ok()) {
+void MPDDisplay::update(const MPDSnapshot &snap, MPDClientThread &net,
+                        const Args &args) {
+  if (!snap.is_ok) {
     return;
   }
 
@@ -216,9 +233,10 @@ void MPDDisplay::update(MPDClient &cli, const Args &args) {
   }
 
   // Check if song changed, invalidate caches if so.
-  if (cached_filename.empty() || cached_filename != cli.get_song_filename()) {
+  if (cached_filename.empty() || cached_filename != snap.song_filename) {
     flags.set(1);
-    cached_filename = cli.get_song_filename();
+    cached_filename = snap.song_filename;
+    attempted_art.reset();
 
     flags.reset(7);
     flags.reset(8);
@@ -234,65 +252,54 @@ void MPDDisplay::update(MPDClient &cli, const Args &args) {
     img_load_fail_count = 0;
 
     flags.set(15);
+
+    // Use the fonts prepared for this song, and lay out its text right away.
+    use_next_font(snap.song_title, TEXT_TITLE);
+    use_next_font(snap.song_artist, TEXT_ARTIST);
+    use_next_font(snap.song_album, TEXT_ALBUM);
+    use_next_font(snap.song_filename, TEXT_FILENAME);
+    flags.set(18);
+  } else {
+    prepare_next_song(snap, args);
   }
 
   if ((!texture || flags.test(1)) && !flags.test(17)) {
     // Load next album art image.
-    const auto &cli_image = cli.get_album_art();
-    if (cli_image.has_value()) {
-      std::string ext;
-      if (cli.get_album_art_mime_type() == "image/jpeg") {
-        ext = ".jpg";
-      } else if (cli.get_album_art_mime_type() == "image/png") {
-        ext = ".png";
-      } else if (cli.get_album_art_mime_type() == "image/gif") {
-        ext = ".gif";
+    // Each fetched image is only tried once, a refetch publishes a new one.
+    const auto &cli_image = snap.album_art;
+    if (cli_image && cli_image != attempted_art) {
+      attempted_art = cli_image;
+      std::unique_ptr<Texture> new_texture;
+      if (cli_image == texture_art && texture) {
+        // Same album art as the previous song, keep its texture.
+        new_texture = std::move(texture);
+      } else if (cli_image == next_texture_art && next_texture) {
+        // Decoded ahead of time, while the previous song played.
+        new_texture = std::move(next_texture);
+        next_texture_art.reset();
+      } else {
+        new_texture =
+            load_album_art_texture(*cli_image, snap.album_art_mime_type);
       }
 
-      LOG_PRINT(level, LogLevel::DEBUG,
-                "Attempting LoadImageFromMemory with size {}, ext {}",
-                cli_image->size(), ext);
-      Image art_img = LoadImageFromMemory(
-          ext.c_str(),
-          reinterpret_cast<const unsigned char *>(cli_image.value().data()),
-          static_cast<int>(cli_image.value().size()));
-      if (art_img.data != nullptr) {
-        if (texture) {
-          UnloadTexture(*texture);
-          texture.reset();
-        }
-
-        texture = std::make_unique<Texture>(LoadTextureFromImage(art_img));
-        if (texture->width != 0 && texture->height != 0) {
-          flags.set(2);
-          flags.reset(1);
-          SetTextureFilter(*texture, TEXTURE_FILTER_BILINEAR);
-          img_load_fail_count = 0;
-        } else {
-          texture.reset();
-          if (img_load_fail_count > MAX_IMAGE_LOAD_FAILURE) {
-            flags.set(17);
-            LOG_PRINT(level, LogLevel::ERROR,
-                      "ERROR: Failed to load album art!");
-          } else {
-            cli.request_refetch_album_art();
-            ++img_load_fail_count;
-          }
-        }
-
-        UnloadImage(art_img);
+      if (texture) {
+        UnloadTexture(*texture);
+        texture.reset();
+      }
+      texture_art.reset();
+
+      if (new_texture) {
+        texture = std::move(new_texture);
+        texture_art = cli_image;
+        flags.set(2);
+        flags.reset(1);
+        img_load_fail_count = 0;
+      } else if (img_load_fail_count > MAX_IMAGE_LOAD_FAILURE) {
+        flags.set(17);
+        LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to load album art!");
       } else {
-        if (texture) {
-          UnloadTexture(*texture);
-          texture.reset();
-        }
-        if (img_load_fail_count > MAX_IMAGE_LOAD_FAILURE) {
-          flags.set(17);
-          LOG_PRINT(level, LogLevel::ERROR, "ERROR: Failed to load album art!");
-        } else {
-          cli.request_refetch_album_art();
-          ++img_load_fail_count;
-        }
+        net.request_refetch_album_art();
+        ++img_load_fail_count;
       }
     }
   }
@@ -334,8 +341,10 @@ void MPDDisplay::update(MPDClient &cli, const Args &args) {
   }
 
   if (!args.get_flags().test(9)) {
-    update_remaining_texts(cli, args);
-    if (now_timepoint - refresh_timepoint > REFRESH_DURATION) {
+    update_remaining_texts(snap, args);
+    if (flags.test(18) ||
+        now_timepoint - refresh_timepoint > REFRESH_DURATION) {
+      flags.reset(18);
       refresh_timepoint = now_timepoint;
       if (flags.test(0)) {
         flags.reset(7);
@@ -351,7 +360,7 @@ void MPDDisplay::update(MPDClient &cli, const Args &args) {
 
         flags.set(15);
       } else {
-        update_draw_texts(cli, args);
+        update_draw_texts(snap, args);
       }
     }
   }
@@ -363,7 +372,7 @@ void MPDDisplay::update(MPDClient &cli, const Args &args) {
   }
 }
 
-void MPDDisplay::draw(const MPDClient &cli, const Args &args) {
+void MPDDisplay::draw(const MPDSnapshot &snap, const Args &args) {
   if (flags.test(5)) {
     if (args.get_bg_grayscale() < 128) {
       DrawText("Failed authenticating to MPD!", 0, 0, 12, WHITE);
@@ -385,7 +394,7 @@ void MPDDisplay::draw(const MPDClient &cli, const Args &args) {
   }
 
   if (!args.get_flags().test(9) && flags.test(16)) {
-    draw_draw_texts(cli, args);
+    draw_draw_texts(snap, args);
   }
 }
 
@@ -449,12 +458,13 @@ float MPDDisplay::scaled_font_size(const Args &args) {
   }
 }
 
-void MPDDisplay::update_remaining_texts(const MPDClient &cli,
+void MPDDisplay::update_remaining_texts(const MPDSnapshot &snap,
                                         const Args &args) {
   auto now = std::chrono::steady_clock::now();
-  double duration = cli.get_song_duration();
+  double duration = snap.song_duration;
   int64_t duration_i = static_cast<int64_t>(duration);
-  auto [elapsed, time_point] = cli.get_elapsed_time();
+  double elapsed = snap.elapsed_time;
+  auto time_point = snap.elapsed_time_point;
 
   auto time_diff = now - time_point;
   double time_diff_seconds =
@@ -517,7 +527,8 @@ void MPDDisplay::update_remaining_texts(const MPDClient &cli,
   }
 }
 
-void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
+void MPDDisplay::update_draw_texts(const MPDSnapshot &snap,
+                                   const Args &args) {
   const int width = GetScreenWidth();
   int y_offset = args.is_y_offset_from_top()
                      ? static_cast<int>(args.get_y_offset() + 0.5F)
@@ -526,9 +537,9 @@ void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
 
   std::shared_ptr<Font> default_font = get_default_font();
 
-  if (!args.get_flags().test(4) && !cli.get_song_filename().empty()) {
+  if (!args.get_flags().test(4) && !snap.song_filename.empty()) {
     Font font = *default_font;
-    load_draw_text_font(cli.get_song_filename(), TEXT_FILENAME, args);
+    load_draw_text_font(snap.song_filename, TEXT_FILENAME, args);
     if (!draw_cached_filename.empty() && !flags.test(14)) {
       auto fiter = fonts.find(TEXT_FILENAME);
       if (fiter != fonts.end()) {
@@ -565,9 +576,9 @@ void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
     }
   }
 
-  if (!args.get_flags().test(3) && !cli.get_song_album().empty()) {
+  if (!args.get_flags().test(3) && !snap.song_album.empty()) {
     Font font = *default_font;
-    load_draw_text_font(cli.get_song_album(), TEXT_ALBUM, args);
+    load_draw_text_font(snap.song_album, TEXT_ALBUM, args);
     if (!draw_cached_album.empty() && !flags.test(13)) {
       auto fiter = fonts.find(TEXT_ALBUM);
       if (fiter != fonts.end()) {
@@ -604,9 +615,9 @@ void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
     }
   }
 
-  if (!args.get_flags().test(2) && !cli.get_song_artist().empty()) {
+  if (!args.get_flags().test(2) && !snap.song_artist.empty()) {
     Font font = *default_font;
-    load_draw_text_font(cli.get_song_artist(), TEXT_ARTIST, args);
+    load_draw_text_font(snap.song_artist, TEXT_ARTIST, args);
     if (!draw_cached_artist.empty() && !flags.test(12)) {
       auto fiter = fonts.find(TEXT_ARTIST);
       if (fiter != fonts.end()) {
@@ -643,9 +654,9 @@ void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
     }
   }
 
-  if (!args.get_flags().test(1) && !cli.get_song_title().empty()) {
+  if (!args.get_flags().test(1) && !snap.song_title.empty()) {
     Font font = *default_font;
-    load_draw_text_font(cli.get_song_title(), TEXT_TITLE, args);
+    load_draw_text_font(snap.song_title, TEXT_TITLE, args);
     if (!draw_cached_title.empty() && !flags.test(11)) {
       auto fiter = fonts.find(TEXT_TITLE);
       if (fiter != fonts.end()) {
@@ -692,14 +703,15 @@ void MPDDisplay::update_draw_texts(const MPDClient &cli, const Args &args) {
   }
 }
 
-void MPDDisplay::draw_draw_texts(const MPDClient &cli, const Args &args) {
-  if (cli.get_play_state() == "stop") {
+void MPDDisplay::draw_draw_texts(const MPDSnapshot &snap,
+                                 const Args &args) {
+  if (snap.play_state == "stop") {
     if (args.get_bg_grayscale() < 128) {
       DrawText("MPD is stopped", 0, 0, STATUS_TEXT_SIZE, WHITE);
     } else {
       DrawText("MPD is stopped", 0, 0, STATUS_TEXT_SIZE, BLACK);
     }
-  } else if (cli.get_play_state() == "pause") {
+  } else if (snap.play_state == "pause") {
     if (args.get_bg_grayscale() < 128) {
       DrawText("MPD is paused", 0, 0, STATUS_TEXT_SIZE, WHITE);
     } else {
@@ -829,26 +841,7 @@ void MPDDisplay::load_draw_text_font(const std::string &text, TextType type,
       break;
   }
 
-  std::string filename;
-  if (args.get_flags().test(10)) {
-    filename = args.get_default_font_filename();
-  } else if (helper_str_is_ascii(text) && args.get_flags().test(11)) {
-    filename = args.get_default_font_filename();
-  } else {
-    filename = helper_unicode_font_fetch(
-        text, args.get_font_blacklist_strings(),
-        args.get_font_whitelist_strings(), args.get_default_font_filename());
-  }
-
-  FontWrapper font{};
-  if (filename.empty()) {
-    if (!args.get_default_font_filename().empty()) {
-      font = FontWrapper(args.get_default_font_filename(), text);
-    }
-  } else {
-    font = FontWrapper(filename, text);
-  }
-
+  FontWrapper font = make_text_font(text, args);
   if (font.get() == nullptr) {
     font = FontWrapper();
     if (font.get() == nullptr) {
@@ -904,3 +897,149 @@ void MPDDisplay::load_draw_text_font(const std::string &text, TextType type,
       break;
   }
 }
+
+FontWrapper MPDDisplay::make_text_font(const std::string &text,
+                                       const Args &args) {
+  std::string filename;
+  if (args.get_flags().test(10)) {
+    filename = args.get_default_font_filename();
+  } else if (helper_str_is_ascii(text) && args.get_flags().test(11)) {
+    filename = args.get_default_font_filename();
+  } else {
+    filename = helper_unicode_font_fetch(
+        text, args.get_font_blacklist_strings(),
+        args.get_font_whitelist_strings(), args.get_default_font_filename());
+  }
+
+  FontWrapper font{};
+  if (filename.empty()) {
+    if (!args.get_default_font_filename().empty()) {
+      font = FontWrapper(args.get_default_font_filename(), text);
+    }
+  } else {
+    font = FontWrapper(filename, text);
+  }
+
+  return font;
+}
+
+std::unique_ptr<Texture> MPDDisplay::load_album_art_texture(
+    const std::vector<char> &data, const std::string &mime_type) {
+  std::string ext;
+  if (mime_type == "image/jpeg") {
+    ext = ".jpg";
+  } else if (mime_type == "image/png") {
+    ext = ".png";
+  } else if (mime_type == "image/gif") {
+    ext = ".gif";
+  }
+
+  LOG_PRINT(level, LogLevel::DEBUG,
+            "Attempting LoadImageFromMemory with size {}, ext {}", data.size(),
+            ext);
+  Image art_img = LoadImageFromMemory(
+      ext.c_str(), reinterpret_cast<const unsigned char *>(data.data()),
+      static_cast<int>(data.size()));
+  if (art_img.data == nullptr) {
+    return nullptr;
+  }
+
+  std::unique_ptr<Texture> art_texture =
+      std::make_unique<Texture>(LoadTextureFromImage(art_img));
+  UnloadImage(art_img);
+  if (art_texture->width == 0 || art_texture->height == 0) {
+    return nullptr;
+  }
+
+  SetTextureFilter(*art_texture, TEXTURE_FILTER_BILINEAR);
+  return art_texture;
+}
+
+void MPDDisplay::prepare_next_song(const MPDSnapshot &snap, const Args &args) {
+  // At most one item is prepared per update, to keep frame times even.
+  if (snap.next_album_art != next_texture_art) {
+    next_texture_art = snap.next_album_art;
+    if (next_texture) {
+      UnloadTexture(*next_texture);
+      next_texture.reset();
+    }
+    if (next_texture_art && next_texture_art != texture_art) {
+      next_texture = load_album_art_texture(*next_texture_art,
+                                            snap.next_album_art_mime_type);
+      return;
+    }
+  }
+
+  if (args.get_flags().test(9)) {
+    return;
+  }
+
+  if (!args.get_flags().test(1) &&
+      prepare_next_font(snap.next_song_title, TEXT_TITLE, args)) {
+    return;
+  } else if (!args.get_flags().test(2) &&
+             prepare_next_font(snap.next_song_artist, TEXT_ARTIST, args)) {
+    return;
+  } else if (!args.get_flags().test(3) &&
+             prepare_next_font(snap.next_song_album, TEXT_ALBUM, args)) {
+    return;
+  } else if (!args.get_flags().test(4)) {
+    prepare_next_font(snap.next_song_filename, TEXT_FILENAME, args);
+  }
+}
+
+bool MPDDisplay::prepare_next_font(const std::string &text, TextType type,
+                                   const Args &args) {
+  if (text.empty()) {
+    return false;
+  } else if (auto iter = next_font_texts.find(type);
+             iter != next_font_texts.end() && iter->second == text) {
+    return false;
+  }
+
+  FontWrapper font = make_text_font(text, args);
+  next_fonts.erase(type);
+  if (font.get() != nullptr) {
+    next_fonts.insert(std::make_pair<int, FontWrapper>(type, std::move(font)));
+  }
+  next_font_texts[type] = text;
+  return true;
+}
+
+void MPDDisplay::use_next_font(const std::string &text, TextType type) {
+  auto text_iter = next_font_texts.find(type);
+  if (text_iter == next_font_texts.end() || text_iter->second != text) {
+    return;
+  }
+  next_font_texts.erase(text_iter);
+
+  auto font_iter = next_fonts.find(type);
+  if (font_iter == next_fonts.end()) {
+    // Failed to load, "load_draw_text_font()" falls back to the default.
+    return;
+  }
+
+  fonts.erase(type);
+  fonts.insert(std::make_pair<int, FontWrapper>(
+      type, std::move(font_iter->second)));
+  next_fonts.erase(font_iter);
+
+  switch (type) {
+    case TEXT_TITLE:
+      flags.set(7);
+      draw_cached_title = text;
+      break;
+    case TEXT_ARTIST:
+      flags.set(8);
+      draw_cached_artist = text;
+      break;
+    case TEXT_ALBUM:
+      flags.set(9);
+      draw_cached_album = text;
+      break;
+    case TEXT_FILENAME:
+      flags.set(10);
+      draw_cached_filename = text;
+      break;
+  }
+}
@@ -24,13 +24,15 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 // local includes
 #include "constants.h"
 
 // forward declarations
 class Args;
-class MPDClient;
+class MPDClientThread;
+struct MPDSnapshot;
 struct Texture;
 struct Font;
 
@@ -74,8 +76,8 @@ class MPDDisplay {
   MPDDisplay(MPDDisplay &&);
   MPDDisplay &operator=(MPDDisplay &&);
 
-  void update(MPDClient &, const Args &);
-  void draw(const MPDClient &, const Args &);
+  void update(const MPDSnapshot &, MPDClientThread &, const Args &);
+  void draw(const MPDSnapshot &, const Args &);
 
   void request_reposition_texture(const Args &);
 
@@ -106,8 +108,16 @@ class MPDDisplay {
   // 15 - MeasureTextEx re-measure requested
   // 16 - H toggle - display text enabled
   // 17 - image loading failed
+  // 18 - song changed, update texts without waiting for the next refresh
   std::bitset<64> flags;
   std::unique_ptr<Texture> texture;
+  // album art "texture" was decoded from
+  std::shared_ptr<const std::vector<char> > texture_art;
+  // last album art given to LoadImageFromMemory
+  std::shared_ptr<const std::vector<char> > attempted_art;
+  // next song's album art, decoded ahead of time
+  std::unique_ptr<Texture> next_texture;
+  std::shared_ptr<const std::vector<char> > next_texture_art;
   std::shared_ptr<Font> raylib_default_font;
   std::shared_ptr<Font> default_font;
   std::string cached_filename;
@@ -119,6 +129,9 @@ class MPDDisplay {
   std::string display_pass;
   std::string remaining_time;
   std::unordered_map<int, FontWrapper> fonts;
+  // next song's fonts, loaded ahead of time, and the text they are for
+  std::unordered_map<int, FontWrapper> next_fonts;
+  std::unordered_map<int, std::string> next_font_texts;
   std::chrono::steady_clock::time_point refresh_timepoint;
   float texture_scale;
   float texture_x;
@@ -149,14 +162,27 @@ class MPDDisplay {
   int filename_y;
   int img_load_fail_count;
 
-  void update_remaining_texts(const MPDClient &, const Args &);
-  void update_draw_texts(const MPDClient &, const Args &);
-  void draw_draw_texts(const MPDClient &, const Args &);
+  void update_remaining_texts(const MPDSnapshot &, const Args &);
+  void update_draw_texts(const MPDSnapshot &, const Args &);
+  void draw_draw_texts(const MPDSnapshot &, const Args &);
 
   std::shared_ptr<Font> get_default_font();
 
   void load_draw_text_font(const std::string &text, TextType type,
                            const Args &);
+  FontWrapper make_text_font(const std::string &text, const Args &);
+
+  /// Returns nullptr if the image can't be loaded.
+  std::unique_ptr<Texture> load_album_art_texture(
+      const std::vector<char> &data, const std::string &mime_type);
+
+  /// Decodes the next song's album art and loads fonts for its text, so the
+  /// song change only has to swap them in.
+  void prepare_next_song(const MPDSnapshot &, const Args &);
+  /// Returns true if a font was loaded.
+  bool prepare_next_font(const std::string &text, TextType type,
+                         const Args &);
+  void use_next_font(const std::string &text, TextType type);
 };
 
 #endif
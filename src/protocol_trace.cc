@@ -0,0 +1,115 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "protocol_trace.h"
+
+// Standard library includes
+#include <utility>
+
+namespace {
+
+constexpr std::string_view TRACE_MAGIC = "MPDTRACE 1\n";
+// time, connection, direction, size
+constexpr size_t RECORD_HEADER_SIZE = 8 + 4 + 1 + 4;
+
+void put_be(char *out, uint64_t value, size_t size) {
+  for (size_t idx = 0; idx < size; ++idx) {
+    out[idx] = static_cast<char>((value >> (8 * (size - idx - 1))) & 0xFF);
+  }
+}
+
+uint64_t get_be(const char *in, size_t size) {
+  uint64_t value = 0;
+  for (size_t idx = 0; idx < size; ++idx) {
+    value = (value << 8) | static_cast<unsigned char>(in[idx]);
+  }
+  return value;
+}
+
+}  // namespace
+
+ProtocolTrace::ProtocolTrace()
+    : start_time(std::chrono::steady_clock::now()),
+      file(),
+      records(),
+      connection_count(0),
+      to_file(false) {}
+
+ProtocolTrace::ProtocolTrace(const std::string &filename)
+    : start_time(std::chrono::steady_clock::now()),
+      file(filename, std::ios::binary | std::ios::trunc),
+      records(),
+      connection_count(0),
+      to_file(true) {
+  file.write(TRACE_MAGIC.data(),
+             static_cast<std::streamsize>(TRACE_MAGIC.size()));
+}
+
+bool ProtocolTrace::is_ok() const { return !to_file || file.good(); }
+
+uint32_t ProtocolTrace::new_connection() { return connection_count++; }
+
+void ProtocolTrace::record(uint32_t connection, Direction direction,
+                           std::string_view data) {
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  if (!to_file) {
+    records.push_back({time, connection, direction, std::string(data)});
+    return;
+  }
+
+  char header[RECORD_HEADER_SIZE];
+  put_be(header, static_cast<uint64_t>(time.count()), 8);
+  put_be(header + 8, connection, 4);
+  put_be(header + 12, direction, 1);
+  put_be(header + 13, data.size(), 4);
+  file.write(header, sizeof(header));
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+const std::vector<ProtocolTrace::Record> &ProtocolTrace::get_records() const {
+  return records;
+}
+
+std::optional<std::vector<ProtocolTrace::Record> > ProtocolTrace::load(
+    const std::string &filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  std::string magic(TRACE_MAGIC.size(), '\0');
+  if (!ifs.read(magic.data(), static_cast<std::streamsize>(magic.size())) ||
+      magic != TRACE_MAGIC) {
+    return std::nullopt;
+  }
+
+  std::vector<Record> loaded;
+  char header[RECORD_HEADER_SIZE];
+  while (ifs.read(header, sizeof(header))) {
+    Record rec;
+    rec.time =
+        std::chrono::microseconds(static_cast<int64_t>(get_be(header, 8)));
+    rec.connection = static_cast<uint32_t>(get_be(header + 8, 4));
+    rec.direction = get_be(header + 12, 1) == DIR_SENT ? DIR_SENT
+                                                         : DIR_RECEIVED;
+    rec.data.resize(get_be(header + 13, 4));
+    if (!ifs.read(rec.data.data(),
+                  static_cast<std::streamsize>(rec.data.size()))) {
+      // Cut off, keep what was complete.
+      break;
+    }
+    loaded.push_back(std::move(rec));
+  }
+  return loaded;
+}
@@ -0,0 +1,84 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_PROTOCOL_TRACE_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_PROTOCOL_TRACE_H_
+
+// Standard library includes
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Records the bytes sent to and received from MPD, with timestamps, per
+/// connection. Written to a file to reproduce a session later with
+/// "TraceReplayServer", or kept in memory.
+///
+/// File format: "MPDTRACE 1\n", then per record the microseconds since the
+/// trace started (8 bytes), the connection (4 bytes), the direction (1 byte)
+/// and the data's size (4 bytes), all big-endian, followed by the data.
+///
+/// Only used from one thread (MPDClientThread's), by the client and its
+/// album art connection.
+class ProtocolTrace {
+ public:
+  enum Direction : uint8_t { DIR_SENT = 0, DIR_RECEIVED = 1 };
+
+  struct Record {
+    // since the trace started
+    std::chrono::microseconds time;
+    uint32_t connection;
+    Direction direction;
+    std::string data;
+  };
+
+  /// Keeps the records in memory, see "get_records()".
+  ProtocolTrace();
+  /// Appends the records to "filename" instead.
+  explicit ProtocolTrace(const std::string &filename);
+
+  // No copy
+  ProtocolTrace(const ProtocolTrace &) = delete;
+  ProtocolTrace &operator=(const ProtocolTrace &) = delete;
+
+  /// False if the file couldn't be written.
+  bool is_ok() const;
+
+  /// Returns the id to record a new connection's data with.
+  uint32_t new_connection();
+  void record(uint32_t connection, Direction direction,
+              std::string_view data);
+
+  /// Empty when writing to a file.
+  const std::vector<Record> &get_records() const;
+
+  /// Returns std::nullopt if "filename" isn't a readable trace.
+  static std::optional<std::vector<Record> > load(
+      const std::string &filename);
+
+ private:
+  std::chrono::steady_clock::time_point start_time;
+  std::ofstream file;
+  std::vector<Record> records;
+  uint32_t connection_count;
+  bool to_file;
+};
+
+#endif
@@ -0,0 +1,123 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "response_parser.h"
+
+// Standard library includes
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+ResponseParser::ResponseParser()
+    : state(ST_LINE), pos(0), scan_pos(0), binary_left(0) {}
+
+void ResponseParser::reset() {
+  state = ST_LINE;
+  pos = 0;
+  scan_pos = 0;
+  binary_left = 0;
+}
+
+ResponseParser::Event ResponseParser::next(std::string_view buf) {
+  while (true) {
+    switch (state) {
+      case ST_LINE: {
+        const char *newline = nullptr;
+        if (scan_pos < buf.size()) {
+          newline = static_cast<const char *>(std::memchr(
+              buf.data() + scan_pos, '\n', buf.size() - scan_pos));
+        }
+        if (!newline) {
+          scan_pos = buf.size();
+          return {EV_NEED_MORE, {}, {}};
+        }
+        size_t newline_idx = static_cast<size_t>(newline - buf.data());
+        std::string_view line = buf.substr(pos, newline_idx - pos);
+        pos = newline_idx + 1;
+        scan_pos = pos;
+
+        if (line == "OK" || line.starts_with("OK MPD ")) {
+          state = ST_DONE;
+          return {EV_OK, {}, line};
+        } else if (line.starts_with("ACK ")) {
+          state = ST_DONE;
+          return {EV_ACK, {}, line};
+        } else if (line == "list_OK") {
+          return {EV_LIST_OK, {}, {}};
+        }
+
+        size_t sep_idx = line.find(": ");
+        if (sep_idx == std::string_view::npos) {
+          return {EV_KEY_VALUE, line, {}};
+        }
+        std::string_view key = line.substr(0, sep_idx);
+        std::string_view value = line.substr(sep_idx + 2);
+        if (key == "binary" &&
+            std::from_chars(value.data(), value.data() + value.size(),
+                            binary_left)
+                    .ec == std::errc{}) {
+          state = ST_BINARY;
+        }
+        return {EV_KEY_VALUE, key, value};
+      }
+      case ST_BINARY: {
+        if (binary_left == 0) {
+          state = ST_BINARY_END;
+          continue;
+        } else if (pos >= buf.size()) {
+          return {EV_NEED_MORE, {}, {}};
+        }
+        size_t size = std::min(binary_left, buf.size() - pos);
+        std::string_view data = buf.substr(pos, size);
+        pos += size;
+        scan_pos = pos;
+        binary_left -= size;
+        return {EV_BINARY, {}, data};
+      }
+      case ST_BINARY_END:
+        // The payload is followed by a newline.
+        if (pos >= buf.size()) {
+          return {EV_NEED_MORE, {}, {}};
+        }
+        if (buf[pos] == '\n') {
+          ++pos;
+        }
+        scan_pos = pos;
+        state = ST_LINE;
+        continue;
+      case ST_DONE:
+      default:
+        return {EV_NEED_MORE, {}, {}};
+    }
+  }
+}
+
+size_t ResponseParser::take_parsed() {
+  size_t parsed = pos;
+  scan_pos -= pos;
+  pos = 0;
+  return parsed;
+}
+
+size_t ResponseParser::binary_remaining() const {
+  return state == ST_BINARY ? binary_left : 0;
+}
+
+void ResponseParser::skip_binary(size_t size) {
+  binary_left -= std::min(size, binary_left);
+}
+
+bool ResponseParser::done() const { return state == ST_DONE; }
@@ -0,0 +1,83 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_RESPONSE_PARSER_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_RESPONSE_PARSER_H_
+
+#include <cstddef>
+#include <string_view>
+
+/// Resumable parser for MPD responses. Bytes are handed in as they arrive and
+/// each byte is looked at once, so a large response costs no rescanning.
+class ResponseParser {
+ public:
+  enum EventType {
+    // No complete event in the given bytes yet.
+    EV_NEED_MORE,
+    // A "key: value" line.
+    EV_KEY_VALUE,
+    // Part of a binary payload (following a "binary: <size>" line).
+    EV_BINARY,
+    // "list_OK" in a "command_list_ok_begin" response.
+    EV_LIST_OK,
+    // "OK" or "OK MPD <version>", ends the response.
+    EV_OK,
+    // "ACK ...", ends the response.
+    EV_ACK
+  };
+
+  struct Event {
+    EventType type;
+    std::string_view key;
+    // Value of a key/value line, the binary data of EV_BINARY, or the whole
+    // line of EV_OK/EV_ACK.
+    std::string_view value;
+  };
+
+  ResponseParser();
+
+  /// Prepares for a new response.
+  void reset();
+
+  /// Returns the next event from "buf". "buf" holds the bytes received that
+  /// were not yet dropped with "take_parsed()", and only grows between calls.
+  Event next(std::string_view buf);
+
+  /// Returns the number of bytes at the front of "buf" that have been parsed.
+  /// The caller drops those from its buffer before calling "next()" again.
+  size_t take_parsed();
+
+  /// Bytes of the current binary payload not yet seen.
+  size_t binary_remaining() const;
+  /// Accounts for "size" payload bytes that were read elsewhere instead of
+  /// being passed to "next()".
+  void skip_binary(size_t size);
+
+  /// True after EV_OK or EV_ACK.
+  bool done() const;
+
+ private:
+  enum State { ST_LINE, ST_BINARY, ST_BINARY_END, ST_DONE };
+
+  State state;
+  // start of the next event
+  size_t pos;
+  // where the search for the next newline resumes
+  size_t scan_pos;
+  size_t binary_left;
+};
+
+#endif
@@ -0,0 +1,146 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "ring_buffer.h"
+
+// Standard library includes
+#include <algorithm>
+#include <cerrno>
+
+// Unix includes
+#include <sys/uio.h>
+
+RingBuffer::RingBuffer() : buf(), buf_capacity(0), head(0), count(0) {}
+
+RingBuffer::RingBuffer(size_t capacity)
+    : buf(std::make_unique_for_overwrite<char[]>(capacity)),
+      buf_capacity(capacity),
+      head(0),
+      count(0) {}
+
+RingBuffer::RingBuffer(RingBuffer &&other)
+    : buf(std::move(other.buf)),
+      buf_capacity(other.buf_capacity),
+      head(other.head),
+      count(other.count) {
+  other.buf_capacity = 0;
+  other.head = 0;
+  other.count = 0;
+}
+
+RingBuffer &RingBuffer::operator=(RingBuffer &&other) {
+  buf = std::move(other.buf);
+  buf_capacity = other.buf_capacity;
+  head = other.head;
+  count = other.count;
+
+  other.buf_capacity = 0;
+  other.head = 0;
+  other.count = 0;
+
+  return *this;
+}
+
+ssize_t RingBuffer::read_from(int fd) { return read_from(fd, buf_capacity); }
+
+ssize_t RingBuffer::read_from(int fd, size_t max_size) {
+  return read_from(fd, nullptr, 0, max_size);
+}
+
+ssize_t RingBuffer::read_from(int fd, char *front, size_t front_size,
+                              size_t max_size) {
+  if (full() && front_size == 0) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  struct iovec iov[3];
+  int iov_count = 0;
+  if (front_size > 0) {
+    iov[0].iov_base = front;
+    iov[0].iov_len = front_size;
+    iov_count = 1;
+  }
+
+  const size_t tail = (head + count) % buf_capacity;
+  if (full() || max_size == 0) {
+    // Only "front".
+  } else if (tail >= head) {
+    // Free space is [tail, end) and [0, head).
+    iov[iov_count].iov_base = buf.get() + tail;
+    iov[iov_count].iov_len = std::min(buf_capacity - tail, max_size);
+    if (head > 0 && iov[iov_count].iov_len < max_size) {
+      iov[iov_count + 1].iov_base = buf.get();
+      iov[iov_count + 1].iov_len =
+          std::min(head, max_size - iov[iov_count].iov_len);
+      ++iov_count;
+    }
+    ++iov_count;
+  } else {
+    // Free space is [tail, head).
+    iov[iov_count].iov_base = buf.get() + tail;
+    iov[iov_count].iov_len = std::min(head - tail, max_size);
+    ++iov_count;
+  }
+
+  ssize_t ret = readv(fd, iov, iov_count);
+  if (ret > 0 && static_cast<size_t>(ret) > front_size) {
+    count += static_cast<size_t>(ret) - front_size;
+  }
+  return ret;
+}
+
+size_t RingBuffer::append(std::string_view data) {
+  const size_t size = std::min(data.size(), buf_capacity - count);
+  const size_t tail = buf_capacity == 0 ? 0 : (head + count) % buf_capacity;
+  // Up to the end of the buffer, then wrapped around to its start.
+  const size_t first_size = std::min(size, buf_capacity - tail);
+  std::copy_n(data.data(), first_size, buf.get() + tail);
+  std::copy_n(data.data() + first_size, size - first_size, buf.get());
+  count += size;
+  return size;
+}
+
+std::string_view RingBuffer::view() {
+  if (head + count > buf_capacity) {
+    // Data wraps around, unwrap it in place.
+    std::rotate(buf.get(), buf.get() + head, buf.get() + buf_capacity);
+    head = 0;
+  }
+  return std::string_view(buf.get() + head, count);
+}
+
+void RingBuffer::consume(size_t count) {
+  if (count >= this->count) {
+    clear();
+  } else {
+    head = (head + count) % buf_capacity;
+    this->count -= count;
+  }
+}
+
+void RingBuffer::clear() {
+  head = 0;
+  count = 0;
+}
+
+size_t RingBuffer::size() const { return count; }
+
+size_t RingBuffer::capacity() const { return buf_capacity; }
+
+bool RingBuffer::empty() const { return count == 0; }
+
+bool RingBuffer::full() const { return count == buf_capacity; }
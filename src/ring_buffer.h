@@ -0,0 +1,74 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_RING_BUFFER_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_RING_BUFFER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+// Unix includes
+#include <sys/types.h>
+
+/// Fixed-size receive buffer, allocated once and reused for every read.
+/// Data is consumed from the front in place.
+class RingBuffer {
+ public:
+  RingBuffer();
+  explicit RingBuffer(size_t capacity);
+
+  // No copy
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  // Allow move
+  RingBuffer(RingBuffer &&);
+  RingBuffer &operator=(RingBuffer &&);
+
+  /// Reads from "fd" into the free space (with "readv()" if it wraps).
+  /// Returns the return value of "readv()".
+  ssize_t read_from(int fd);
+  /// Same as above, but reads at most "max_size" bytes.
+  ssize_t read_from(int fd, size_t max_size);
+  /// Same as above, but the first "front_size" bytes go to "front" instead,
+  /// so that data that follows it is read with the same call. Returns the
+  /// total read, of which the first "front_size" bytes went to "front".
+  ssize_t read_from(int fd, char *front, size_t front_size, size_t max_size);
+  /// Copies as much of "data" as fits into the free space. Returns the size
+  /// copied.
+  size_t append(std::string_view data);
+
+  /// Returns all unconsumed data as one contiguous view. Unwraps the data in
+  /// place if necessary. Valid until the next non-const call.
+  std::string_view view();
+
+  void consume(size_t count);
+  void clear();
+
+  size_t size() const;
+  size_t capacity() const;
+  bool empty() const;
+  bool full() const;
+
+ private:
+  std::unique_ptr<char[]> buf;
+  size_t buf_capacity;
+  size_t head;
+  size_t count;
+};
+
+#endif
@@ -14,11 +14,31 @@
 // OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "album_art_cache.h"
 #include "helpers.h"
+#include "host_resolver.h"
+#include "io_uring_socket.h"
+#include "mock_mpd.h"
 #include "mpd_client.h"
 #include "print_helper.h"
+#include "protocol_trace.h"
+#include "response_parser.h"
+#include "ring_buffer.h"
+#include "trace_replay.h"
+#include "triple_buffer.h"
 
 static std::atomic_uint64_t checked;
 static std::atomic_uint64_t passed;
@@ -45,6 +65,75 @@ static std::atomic_uint64_t passed;
     }                                                                        \
   } while (false);
 
+// Counts heap allocations made by the thread that sets "count_allocs".
+static std::atomic_uint64_t alloc_count;
+static thread_local bool count_allocs = false;
+
+void *operator new(std::size_t size) {
+  if (count_allocs) {
+    ++alloc_count;
+  }
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// Socket path of the test servers of this process.
+static std::string test_socket_path() {
+  return std::format("/tmp/mpd_info_screen2_test_{}.sock",
+                     static_cast<int>(getpid()));
+}
+
+// A MockMPD at "test_socket_path()", run on its own thread by "start()" once
+// its options are set. Stopped and its socket removed when out of scope, so
+// declare the MPDClient after it.
+class MockMPDFixture : public MockMPD {
+ public:
+  MockMPDFixture() : MockMPD(test_socket_path()), path(test_socket_path()) {}
+
+  ~MockMPDFixture() {
+    stop.store(true);
+    if (thread.joinable()) {
+      thread.join();
+    }
+    unlink(path.c_str());
+  }
+
+  void start() { thread = std::thread(&MockMPD::run, this); }
+
+  const std::string path;
+
+ private:
+  std::thread thread;
+};
+
+// Calls "update()" on "cli" until "done()" returns true, or "timeout" passed.
+// Returns the last result of "done()".
+template <typename Done>
+static bool run_until(MPDClient &cli, Done done,
+                      std::chrono::milliseconds timeout) {
+  const auto start = std::chrono::steady_clock::now();
+  while (!done()) {
+    if (std::chrono::steady_clock::now() - start >= timeout) {
+      return false;
+    }
+    cli.update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  return true;
+}
+
+// Calls "update()" on "cli" for "duration".
+static void run_for(MPDClient &cli, std::chrono::milliseconds duration) {
+  run_until(cli, [] { return false; }, duration);
+}
+
 int main(void) {
   // ipv4 str to value
   {
@@ -72,6 +161,112 @@ int main(void) {
     CHECK_TRUE(cli.is_ok());
   }
 
+  // MPDClient fails on a unix socket path that doesn't fit, and a reset
+  // starts over from connecting
+  {
+    MPDClient cli(std::string(200, 'a'), 0, LogLevel::SILENT, true);
+    CHECK_TRUE(cli.is_ok());
+    cli.update();
+    CHECK_FALSE(cli.is_ok());
+    CHECK_FALSE(cli.is_connecting());
+    cli.reset_connection();
+    CHECK_TRUE(cli.is_ok());
+    cli.update();
+    CHECK_FALSE(cli.is_ok());
+  }
+
+  // MPDClient connect is non-blocking and fails on a refused connection
+  {
+    // Bound but not listening, so connecting to it is refused.
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(struct sockaddr_in);
+    bind(fd, reinterpret_cast<struct sockaddr *>(&addr), addr_len);
+    getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len);
+
+    MPDClient cli("127.0.0.1", ntohs(addr.sin_port), LogLevel::SILENT, false,
+                  std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.is_ok());
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100 && cli.is_ok(); ++i) {
+      cli.update();
+      cli.wait_for_io(-1, 10);
+    }
+    CHECK_FALSE(cli.is_ok());
+    CHECK_FALSE(cli.is_connecting());
+    CHECK_TRUE(std::chrono::steady_clock::now() - start <
+               std::chrono::milliseconds(1000));
+    close(fd);
+  }
+
+  // HostResolver
+  {
+    CHECK_TRUE(HostResolver::is_valid_host("localhost"));
+    CHECK_TRUE(HostResolver::is_valid_host("::1"));
+    CHECK_TRUE(HostResolver::is_valid_host("192.168.0.2"));
+    CHECK_FALSE(HostResolver::is_valid_host("127.1"));
+    CHECK_FALSE(HostResolver::is_valid_host(""));
+
+    std::vector<SockAddr> addrs(5);
+    addrs[0].addr.ss_family = AF_INET6;
+    addrs[1].addr.ss_family = AF_INET6;
+    addrs[2].addr.ss_family = AF_INET6;
+    addrs[3].addr.ss_family = AF_INET;
+    addrs[4].addr.ss_family = AF_INET;
+    addrs[0].len = 0;
+    addrs[3].len = 3;
+    HostResolver::interleave_families(addrs);
+    CHECK_TRUE(addrs[0].addr.ss_family == AF_INET6 && addrs[0].len == 0);
+    CHECK_TRUE(addrs[1].addr.ss_family == AF_INET && addrs[1].len == 3);
+    CHECK_TRUE(addrs[2].addr.ss_family == AF_INET6);
+    CHECK_TRUE(addrs[3].addr.ss_family == AF_INET);
+    CHECK_TRUE(addrs[4].addr.ss_family == AF_INET6);
+  }
+
+  // HostResolvers of the same host share its lookup, and both get results
+  {
+    HostResolver first;
+    HostResolver second;
+    first.start("localhost", 6600);
+    second.start("localhost", 6600);
+    for (int i = 0; i < 500 && !(first.is_done() && second.is_done()); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    CHECK_TRUE(first.is_done() && second.is_done());
+    std::vector<SockAddr> first_addrs = first.take_results();
+    std::vector<SockAddr> second_addrs = second.take_results();
+    CHECK_FALSE(first_addrs.empty());
+    CHECK_TRUE(first_addrs.size() == second_addrs.size());
+  }
+
+  // MPDClient resolves a host name and connects
+  {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(struct sockaddr_in);
+    bind(fd, reinterpret_cast<struct sockaddr *>(&addr), addr_len);
+    getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len);
+    listen(fd, 1);
+
+    MPDClient cli("localhost", ntohs(addr.sin_port), LogLevel::SILENT, false);
+    for (int i = 0; i < 200 && cli.is_ok(); ++i) {
+      cli.update();
+      if (!cli.is_connecting()) {
+        break;
+      }
+      cli.wait_for_io(-1, 10);
+    }
+    CHECK_TRUE(cli.is_ok());
+    CHECK_FALSE(cli.is_connecting());
+    close(fd);
+  }
+
   // helper_replace_in_string
   {
     std::string ret =
@@ -98,6 +293,521 @@ int main(void) {
     CHECK_TRUE(swapped == 0x78563412);
   }
 
+  // ResponseParser, fed one byte at a time
+  {
+    std::string response(
+        "size: 5\ntype: image/png\nbinary: 3\nab\n\nlist_OK\nOK\n");
+    ResponseParser parser;
+    std::string buf;
+    std::string binary;
+    std::string keys;
+    int list_ok_count = 0;
+    bool ok = false;
+    for (char c : response) {
+      buf.push_back(c);
+      ResponseParser::Event event;
+      while ((event = parser.next(buf)).type != ResponseParser::EV_NEED_MORE) {
+        if (event.type == ResponseParser::EV_KEY_VALUE) {
+          keys.append(event.key);
+          keys.append("=");
+          keys.append(event.value);
+          keys.append(",");
+        } else if (event.type == ResponseParser::EV_BINARY) {
+          binary.append(event.value);
+        } else if (event.type == ResponseParser::EV_LIST_OK) {
+          ++list_ok_count;
+        } else if (event.type == ResponseParser::EV_OK) {
+          ok = true;
+        }
+      }
+      buf.erase(0, parser.take_parsed());
+    }
+    CHECK_TRUE(keys == "size=5,type=image/png,binary=3,");
+    CHECK_TRUE(binary == "ab\n");
+    CHECK_TRUE(list_ok_count == 1);
+    CHECK_TRUE(ok);
+    CHECK_TRUE(parser.done());
+    CHECK_TRUE(buf.empty());
+
+    parser.reset();
+    ResponseParser::Event event = parser.next("ACK [50@0] {albumart} none\n");
+    CHECK_TRUE(event.type == ResponseParser::EV_ACK);
+    CHECK_TRUE(event.value == "ACK [50@0] {albumart} none");
+  }
+
+  // RingBuffer reads a payload and what follows it with one call
+  {
+    int pipe_fds[2];
+    CHECK_TRUE(pipe(pipe_fds) == 0);
+    std::string sent("payload\nOK\n");
+    CHECK_TRUE(write(pipe_fds[1], sent.data(), sent.size()) ==
+               static_cast<ssize_t>(sent.size()));
+
+    RingBuffer buf(16);
+    char payload[7];
+    CHECK_TRUE(buf.read_from(pipe_fds[0], payload, sizeof(payload), 16) ==
+               static_cast<ssize_t>(sent.size()));
+    CHECK_TRUE(std::string(payload, sizeof(payload)) == "payload");
+    CHECK_TRUE(buf.view() == "\nOK\n");
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+  }
+
+  // RingBuffer appends across the wrap, as much as fits
+  {
+    RingBuffer buf(8);
+    CHECK_TRUE(buf.append("abcdef") == 6);
+    buf.consume(4);
+    CHECK_TRUE(buf.append("ghijklmn") == 6);
+    CHECK_TRUE(buf.view() == "efghijkl");
+  }
+
+  // TripleBuffer
+  {
+    TripleBuffer<int> buffer;
+    CHECK_FALSE(buffer.fetch());
+    buffer.get_back() = 1;
+    buffer.publish();
+    buffer.get_back() = 2;
+    buffer.publish();
+    CHECK_TRUE(buffer.fetch());
+    CHECK_TRUE(buffer.get_front() == 2);
+    CHECK_FALSE(buffer.fetch());
+
+    // The reader must never see a partially written value.
+    struct Pair {
+      uint64_t a = 0;
+      uint64_t b = 0;
+    };
+    TripleBuffer<Pair> pairs;
+    std::thread writer([&pairs]() {
+      for (uint64_t i = 1; i <= 100000; ++i) {
+        pairs.get_back().a = i;
+        pairs.get_back().b = i;
+        pairs.publish();
+      }
+    });
+    bool consistent = true;
+    uint64_t last = 0;
+    while (last < 100000) {
+      if (pairs.fetch()) {
+        const Pair &pair = pairs.get_front();
+        consistent = consistent && pair.a == pair.b && pair.a > last;
+        last = pair.a;
+      }
+    }
+    writer.join();
+    CHECK_TRUE(consistent);
+  }
+
+  // MPDClient steady state does not allocate
+  {
+    MockMPDFixture server;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_song_title() == "Title"; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.get_song_title() == "Title");
+    // Let the art fetch fail and the client settle in "idle".
+    run_for(cli, std::chrono::milliseconds(40));
+
+    count_allocs = true;
+    for (int i = 0; i < 100; ++i) {
+      cli.update();
+    }
+    // A "changed: player" for the same song only refetches "status".
+    server.send_change.store(true);
+    run_until(cli, [&] { return server.status_sent.load() >= 1; },
+              std::chrono::milliseconds(1000));
+    run_for(cli, std::chrono::milliseconds(40));
+    count_allocs = false;
+
+    CHECK_TRUE(server.status_sent.load() == 1);
+    CHECK_TRUE(server.song_info_sent.load() == 1);
+    CHECK_TRUE(cli.get_song_duration() == 200.0);
+    CHECK_TRUE(std::get<0>(cli.get_elapsed_time()) == 12.5);
+    CHECK_TRUE(alloc_count.load() == 0);
+    PrintHelper::println("Allocations in steady state: {}", alloc_count.load());
+  }
+
+  // binarylimit chosen from the measured throughput
+  {
+    using std::chrono::microseconds;
+    CHECK_TRUE(MPDClient::choose_binary_limit(1e9, microseconds(100)) ==
+               MPD_BINARY_LIMIT);
+    CHECK_TRUE(MPDClient::choose_binary_limit(10240.0, microseconds(20000)) ==
+               MPD_BINARY_LIMIT_MIN);
+    // 80 ms of transfer at 1 MiB/s
+    CHECK_TRUE(MPDClient::choose_binary_limit(1048576.0,
+                                              microseconds(20000)) == 82944);
+    // A round trip longer than the target still leaves a quarter of it.
+    CHECK_TRUE(MPDClient::choose_binary_limit(1048576.0,
+                                              microseconds(500000)) == 25600);
+  }
+
+  // MPDClient prefetches the next song, and uses it once it plays
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_next_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.get_song_filename() == "dir/a.flac");
+    CHECK_TRUE(cli.get_next_song_filename() == "dir/b.flac");
+    CHECK_TRUE(cli.get_next_song_title() == "Next");
+    auto next_art = cli.get_next_album_art();
+    CHECK_TRUE(next_art &&
+               std::string(next_art->begin(), next_art->end()) ==
+                   "dir/b.flac");
+
+    server.send_change.store(true);
+    run_until(cli, [&] { return cli.get_song_filename() == "dir/b.flac"; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.get_song_filename() == "dir/b.flac");
+    // Same data, it was not fetched again.
+    CHECK_TRUE(cli.get_album_art() == next_art);
+    // "status" alone noticed the new song, then only "currentsong" was
+    // fetched.
+    CHECK_TRUE(server.song_info_lists_received.load() == 1);
+    CHECK_TRUE(server.song_info_sent.load() == 2);
+  }
+
+  // MPDClient requests the album art chunks after the first in command lists
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.art_chunk_size = 3;
+    server.short_second_chunk = true;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_next_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+    art = cli.get_next_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/b.flac");
+
+    // The short second chunk costs one more command list.
+    CHECK_TRUE(server.art_lists_received == 3);
+  }
+
+  // A slow album art transfer on its own connection doesn't hold up the
+  // song change
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.art_delay = std::chrono::milliseconds(600);
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return server.connections.load() >= 2; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(server.connections.load() == 2);
+    run_for(cli, std::chrono::milliseconds(50));
+    CHECK_TRUE(cli.get_song_filename() == "dir/a.flac");
+
+    auto start = std::chrono::steady_clock::now();
+    server.send_change.store(true);
+    run_until(cli, [&] { return cli.get_song_filename() == "dir/b.flac"; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.get_song_filename() == "dir/b.flac");
+    CHECK_TRUE(std::chrono::steady_clock::now() - start <
+               std::chrono::milliseconds(300));
+    CHECK_FALSE(cli.get_album_art());
+  }
+
+  // Album art arrives the same with and without io_uring, which is used
+  // whenever it is built in and the kernel allows it
+  {
+    bool uring_works = false;
+    int sock_fds[2];
+    CHECK_TRUE(socketpair(AF_UNIX, SOCK_STREAM, 0, sock_fds) == 0);
+    {
+      IoUringSocket probe;
+      uring_works = probe.open(sock_fds[0]);
+    }
+    close(sock_fds[0]);
+    close(sock_fds[1]);
+
+    for (bool enabled : {false, true}) {
+      MockMPDFixture server;
+      server.play_queue = true;
+      server.max_connections = 1;
+      server.art_chunk_size = 3;
+      server.start();
+
+      MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+      cli.set_io_uring(enabled);
+      run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+                std::chrono::milliseconds(1000));
+      auto art = cli.get_album_art();
+      CHECK_TRUE(art &&
+                 std::string(art->begin(), art->end()) == "dir/a.flac");
+      CHECK_TRUE(cli.is_using_io_uring() == (enabled && uring_works));
+    }
+  }
+
+  // Album art is fetched on the main connection if a second one isn't allowed
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.max_connections = 1;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+  }
+
+  // An idle connection is checked once MPD has been quiet for the heartbeat
+  // interval
+  {
+    MockMPDFixture server;
+    server.max_connections = 1;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true,
+                  MPD_CLI_CONNECT_TIMEOUT, std::chrono::milliseconds(50));
+    const auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start <
+           std::chrono::milliseconds(400)) {
+      cli.update();
+      // Waking up for the heartbeat doesn't wait on this timeout.
+      cli.wait_for_io(-1, 1000);
+    }
+    CHECK_TRUE(cli.is_ok());
+    CHECK_TRUE(server.noidle_received.load() >= 3);
+  }
+
+  // Song info is fetched again between album art requests that take long
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.max_connections = 1;
+    server.art_chunk_size = 3;
+    server.art_delay = std::chrono::milliseconds(300);
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(4000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+    CHECK_TRUE(server.status_sent.load() >= 1);
+  }
+
+  // Album art bigger than "binarylimit" arrives whole over a slow link
+  {
+    MockMPDFixture server;
+    server.art_size = 3000000;
+    server.bytes_per_second = 20000000;
+    server.reply_delay = std::chrono::milliseconds(5);
+    server.start();
+
+    const auto start = std::chrono::steady_clock::now();
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(3000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) ==
+                          server.generated_art());
+    CHECK_TRUE(server.art_chunks_sent.load() > 1);
+    // At least the time to send it at 20 MB/s.
+    CHECK_TRUE(std::chrono::steady_clock::now() - start >=
+               std::chrono::milliseconds(150));
+  }
+
+  // ProtocolTrace file round trip
+  {
+    std::string path = std::format("/tmp/mpd_info_screen2_test_{}.trace",
+                                   static_cast<int>(getpid()));
+    {
+      ProtocolTrace trace(path);
+      CHECK_TRUE(trace.is_ok());
+      uint32_t conn = trace.new_connection();
+      trace.record(conn, ProtocolTrace::DIR_RECEIVED, "OK MPD 0.24.0\n");
+      trace.record(trace.new_connection(), ProtocolTrace::DIR_SENT,
+                   std::string("a\0b", 3));
+    }
+    auto records = ProtocolTrace::load(path);
+    CHECK_TRUE(records.has_value() && records->size() == 2);
+    if (records.has_value() && records->size() == 2) {
+      CHECK_TRUE(records->at(0).connection == 0);
+      CHECK_TRUE(records->at(0).direction == ProtocolTrace::DIR_RECEIVED);
+      CHECK_TRUE(records->at(0).data == "OK MPD 0.24.0\n");
+      CHECK_TRUE(records->at(1).connection == 1);
+      CHECK_TRUE(records->at(1).direction == ProtocolTrace::DIR_SENT);
+      CHECK_TRUE(records->at(1).data == std::string("a\0b", 3));
+      CHECK_TRUE(records->at(0).time <= records->at(1).time);
+    }
+    unlink(path.c_str());
+    CHECK_FALSE(ProtocolTrace::load(path).has_value());
+  }
+
+  // A recorded session replays to a new client
+  {
+    auto trace = std::make_shared<ProtocolTrace>();
+    {
+      MockMPDFixture server;
+      server.play_queue = true;
+      server.start();
+
+      MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+      cli.set_trace(trace);
+      run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+                std::chrono::milliseconds(1000));
+      CHECK_TRUE(cli.get_album_art());
+    }
+
+    const std::string path = test_socket_path();
+    TraceReplayServer replay(path, trace->get_records(), 0.0);
+    // The main connection and the album art connection.
+    CHECK_TRUE(replay.connection_count() == 2);
+    std::thread replay_thread(&TraceReplayServer::run, &replay);
+
+    MPDClient cli(path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.get_song_title() == "Title");
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+    CHECK_TRUE(replay.mismatches.load() == 0);
+
+    replay.stop.store(true);
+    cli.reset_connection();
+    replay_thread.join();
+    unlink(path.c_str());
+  }
+
+  // AlbumArtCache
+  {
+    CHECK_TRUE(AlbumArtCache::directory_of("a/b/c.flac") == "a/b");
+    CHECK_TRUE(AlbumArtCache::directory_of("c.flac").empty());
+
+    AlbumArtCache cache;
+    CHECK_TRUE(cache.find("dir/a.flac") == nullptr);
+    cache.record("dir/a.flac", false, false, 0);
+    cache.record("dir/a.flac", true, true, 1234);
+    const AlbumArtSource *source = cache.find("dir/b.flac");
+    CHECK_TRUE(source && source->readpicture == AlbumArtSource::MISSING &&
+               source->albumart == AlbumArtSource::FOUND &&
+               source->size == 1234);
+
+    for (size_t idx = 0; idx < MPD_CLI_ART_CACHE_DIRS; ++idx) {
+      cache.record(std::format("other{}/a.flac", idx), false, true, 1);
+    }
+    CHECK_TRUE(cache.size() == MPD_CLI_ART_CACHE_DIRS);
+    // The oldest directory was dropped.
+    CHECK_TRUE(cache.find("dir/a.flac") == nullptr);
+  }
+
+  // Songs after the first in a directory without embedded pictures go
+  // straight to "albumart"
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.cover_file_only = true;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_next_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/cover");
+    art = cli.get_next_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/cover");
+    CHECK_TRUE(server.readpicture_requests.load() == 1);
+  }
+
+  // A song without an embedded picture doesn't stop the next songs of a
+  // directory without a cover file from trying theirs
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.song_without_picture = "dir/a.flac";
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_next_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    CHECK_FALSE(cli.get_album_art());
+    auto art = cli.get_next_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/b.flac");
+  }
+
+  // Album art shared by the songs of a directory is only fetched once
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.cover_file_only = true;
+    server.art_chunk_size = 3;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_next_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/cover");
+    // The same data, so the display can keep its texture.
+    CHECK_TRUE(cli.get_next_album_art() == art);
+    // All of it once, then only the first chunk.
+    CHECK_TRUE(server.art_bytes_sent.load() == 9 + 3);
+  }
+
+  // MPDClient authenticates without blocking, also on the album art
+  // connection
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.password = "pass word";
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.needs_auth(); },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.needs_auth());
+
+    cli.attempt_auth("wrong");
+    // Only queued, the reply is handled by "update()".
+    CHECK_TRUE(cli.is_authenticating());
+    run_until(cli, [&] { return !cli.is_authenticating(); },
+              std::chrono::milliseconds(1000));
+    CHECK_TRUE(cli.auth_failed() && cli.needs_auth());
+
+    cli.attempt_auth("pass word");
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(1000));
+    CHECK_FALSE(cli.auth_failed() || cli.needs_auth());
+    CHECK_TRUE(cli.get_song_title() == "Title");
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+    // The album art came from its own connection.
+    CHECK_TRUE(server.connections.load() == 2);
+  }
+
+  // Album art interrupted by a lost connection continues where it stopped
+  {
+    MockMPDFixture server;
+    server.play_queue = true;
+    server.art_chunk_size = 3;
+    server.drop_after_chunks = 2;
+    server.start();
+
+    MPDClient cli(server.path, 0, LogLevel::SILENT, true);
+    run_until(cli, [&] { return cli.get_album_art() != nullptr; },
+              std::chrono::milliseconds(3000));
+    auto art = cli.get_album_art();
+    CHECK_TRUE(art && std::string(art->begin(), art->end()) == "dir/a.flac");
+    // Nothing was fetched twice.
+    CHECK_TRUE(server.art_bytes_sent.load() == 10);
+  }
+
   PrintHelper::println("Checked: {}\nPassed: {}", checked.load(),
                        passed.load());
 
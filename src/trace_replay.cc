@@ -0,0 +1,186 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "trace_replay.h"
+
+// Standard library includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+
+// Unix includes
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+bool wait_readable(int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 50) > 0;
+}
+
+}  // namespace
+
+TraceReplayServer::TraceReplayServer(
+    const std::string &path, const std::vector<ProtocolTrace::Record> &records,
+    double speed)
+    : stop(false),
+      connections_done(0),
+      mismatches(0),
+      connections(),
+      speed(speed),
+      listen_fd(-1) {
+  // Connection ids are handed out in the order the connections were opened.
+  std::map<uint32_t, std::vector<ProtocolTrace::Record> > by_connection;
+  for (const ProtocolTrace::Record &rec : records) {
+    by_connection[rec.connection].push_back(rec);
+  }
+  for (auto &[id, connection_records] : by_connection) {
+    connections.push_back(std::move(connection_records));
+  }
+
+  unlink(path.c_str());
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(),
+              std::min(path.size() + 1, sizeof(addr.sun_path) - 1));
+  bind(listen_fd, reinterpret_cast<const struct sockaddr *>(&addr),
+       sizeof(addr));
+  listen(listen_fd, 4);
+}
+
+TraceReplayServer::~TraceReplayServer() { close(listen_fd); }
+
+void TraceReplayServer::run() {
+  std::vector<std::thread> threads;
+  size_t next = 0;
+  while (!stop.load()) {
+    if (!wait_readable(listen_fd)) {
+      continue;
+    }
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    } else if (next >= connections.size()) {
+      // Not in the recording, like a connection MPD refused.
+      close(fd);
+      continue;
+    }
+    threads.emplace_back(&TraceReplayServer::serve, this, fd,
+                         std::cref(connections[next++]));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+size_t TraceReplayServer::connection_count() const {
+  return connections.size();
+}
+
+void TraceReplayServer::serve(
+    int fd, const std::vector<ProtocolTrace::Record> &records) {
+  // Replies are timed from the request they answer.
+  auto anchor_time = std::chrono::steady_clock::now();
+  std::chrono::microseconds anchor_trace_time(0);
+  if (!records.empty()) {
+    anchor_trace_time = records.front().time;
+  }
+
+  std::string received;
+  char read_buf[4096];
+  for (const ProtocolTrace::Record &rec : records) {
+    if (rec.direction == ProtocolTrace::DIR_SENT) {
+      size_t line_count = static_cast<size_t>(
+          std::count(rec.data.begin(), rec.data.end(), '\n'));
+      size_t line_end = 0;
+      while (line_count > 0) {
+        size_t newline_idx = received.find('\n', line_end);
+        if (newline_idx != std::string::npos) {
+          line_end = newline_idx + 1;
+          --line_count;
+          continue;
+        }
+        if (stop.load()) {
+          close(fd);
+          return;
+        } else if (!wait_readable(fd)) {
+          continue;
+        }
+        ssize_t read_ret = recv(fd, read_buf, sizeof(read_buf), 0);
+        if (read_ret <= 0) {
+          // The client went away.
+          close(fd);
+          return;
+        }
+        received.append(read_buf, static_cast<size_t>(read_ret));
+      }
+      if (line_end > 0 && received.compare(0, line_end, rec.data) != 0) {
+        ++mismatches;
+      }
+      received.erase(0, line_end);
+      anchor_time = std::chrono::steady_clock::now();
+      anchor_trace_time = rec.time;
+      continue;
+    }
+
+    if (speed > 0.0) {
+      auto send_time =
+          anchor_time +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              (rec.time - anchor_trace_time) / speed);
+      while (!stop.load() && std::chrono::steady_clock::now() < send_time) {
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(
+                send_time - std::chrono::steady_clock::now(),
+                std::chrono::milliseconds(50)));
+      }
+      if (stop.load()) {
+        close(fd);
+        return;
+      }
+    }
+    size_t sent = 0;
+    while (sent < rec.data.size()) {
+      ssize_t send_ret = send(fd, rec.data.data() + sent,
+                              rec.data.size() - sent, MSG_NOSIGNAL);
+      if (send_ret <= 0) {
+        close(fd);
+        return;
+      }
+      sent += static_cast<size_t>(send_ret);
+    }
+  }
+  ++connections_done;
+
+  // MPD didn't close the connection when the recording ended either.
+  while (!stop.load()) {
+    if (wait_readable(fd) && recv(fd, read_buf, sizeof(read_buf), 0) <= 0) {
+      break;
+    }
+  }
+  close(fd);
+}
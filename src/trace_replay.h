@@ -0,0 +1,72 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_TRACE_REPLAY_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_TRACE_REPLAY_H_
+
+// Standard library includes
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// local includes
+#include "protocol_trace.h"
+
+/// Stands in for MPD on a unix socket by replaying a "ProtocolTrace". The
+/// n-th accepted connection replays the n-th recorded one, connections past
+/// the recorded ones are closed right away. What the client
+/// sent is waited for a line at a time (differences are only counted, so a
+/// different "binarylimit" doesn't derail it), and what MPD sent is sent
+/// back with the recorded delays divided by "speed".
+///
+/// Requests the client sends on its own timer, like a heartbeat "noidle",
+/// are still waited for in real time.
+class TraceReplayServer {
+ public:
+  /// With "speed" 0, replies are sent without any delay.
+  TraceReplayServer(const std::string &path,
+                    const std::vector<ProtocolTrace::Record> &records,
+                    double speed);
+  ~TraceReplayServer();
+
+  // No copy
+  TraceReplayServer(const TraceReplayServer &) = delete;
+  TraceReplayServer &operator=(const TraceReplayServer &) = delete;
+
+  /// Serves connections until "stop" is set. Connections stay open after
+  /// their recording ends.
+  void run();
+
+  size_t connection_count() const;
+
+  std::atomic_bool stop;
+  // recorded connections replayed to the end
+  std::atomic_uint64_t connections_done;
+  // lines from the client that differ from the recording
+  std::atomic_uint64_t mismatches;
+
+ private:
+  // records of each recorded connection, in the order they were opened
+  std::vector<std::vector<ProtocolTrace::Record> > connections;
+  double speed;
+  int listen_fd;
+
+  void serve(int fd, const std::vector<ProtocolTrace::Record> &records);
+};
+
+#endif
@@ -0,0 +1,68 @@
+// ISC License
+//
+// Copyright (c) 2026 Stephen Seo
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+// OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SEODISPARATE_COM_MPD_INFO_SCREEN_2_TRIPLE_BUFFER_H_
+#define SEODISPARATE_COM_MPD_INFO_SCREEN_2_TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+
+/// Lock-free handoff of the latest value from one writer thread to one reader
+/// thread. The writer fills "get_back()" and calls "publish()"; the reader
+/// calls "fetch()" and then reads "get_front()". Neither side ever waits.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : buffers(), back(0), middle(1), front(2) {}
+
+  // No copy/move, shared between threads.
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  /// Writer only. Holds stale data from an earlier "publish()".
+  T &get_back() { return buffers[back]; }
+
+  /// Writer only. Hands the back buffer to the reader.
+  void publish() {
+    back = middle.exchange(back | NEW_BIT, std::memory_order_acq_rel) &
+           INDEX_MASK;
+  }
+
+  /// Reader only. Returns true if a newer value is now in "get_front()".
+  bool fetch() {
+    if (!(middle.load(std::memory_order_relaxed) & NEW_BIT)) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  /// Reader only.
+  const T &get_front() const { return buffers[front]; }
+
+ private:
+  static constexpr unsigned int INDEX_MASK = 0x3;
+  static constexpr unsigned int NEW_BIT = 0x4;
+
+  std::array<T, 3> buffers;
+  unsigned int back;
+  // index of the buffer between the writer and reader, with "NEW_BIT" set if
+  // it was published and not yet fetched
+  std::atomic_uint middle;
+  unsigned int front;
+};
+
+#endif